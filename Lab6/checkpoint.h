@@ -0,0 +1,127 @@
+#pragma once
+// Контрольные точки сетки в отображенном в память файле.
+// Файл: заголовок на отдельной странице и два слота по m x m double.
+// Слоты пишутся по очереди. Заголовок меняется одной записью после сброса
+// данных на диск: новый слот становится действительным, старый пустым,
+// так что перезаписывается всегда пустой слот и прерывание посреди
+// записи оставляет предыдущую точку целой.
+#include <atomic>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define CHECKPOINT_MAGIC "JACOBICK"
+#define CHECKPOINT_DATA 4096 // смещение первого слота, граница страницы
+
+struct checkpoint_header {
+    char magic[8];
+    int m;
+    int iters[2];      // итерация в слоте, -1 - слот пуст
+    double errors[2];
+};
+
+struct checkpoint_file {
+    int fd = -1;
+    int m = 0;
+    size_t size = 0;
+    char* base = nullptr;
+    int next_slot = 0;
+    std::thread writer;
+    std::atomic<bool> copied{true};
+    std::atomic<bool> finished{true};
+
+    checkpoint_header* header() { return (checkpoint_header*)base; }
+    double* slot(int s) { return (double*)(base + CHECKPOINT_DATA) + (size_t)s * m * m; }
+};
+
+// самая свежая сохраненная точка
+inline int checkpoint_latest(checkpoint_file& ck) {
+    checkpoint_header* h = ck.header();
+    return h->iters[0] > h->iters[1] ? 0 : 1;
+}
+
+// keep = true - открыть существующий файл для рестарта (проверяются
+// сигнатура и размер сетки), иначе создать новый с пустыми слотами.
+// Возвращает текст ошибки, пустая строка - успех
+inline std::string checkpoint_open(checkpoint_file& ck, const std::string& path, int m, bool keep) {
+    ck.m = m;
+    ck.size = CHECKPOINT_DATA + 2 * (size_t)m * m * sizeof(double);
+    ck.fd = open(path.c_str(), keep ? O_RDWR : (O_RDWR | O_CREAT | O_TRUNC), 0644);
+    if (ck.fd < 0)
+        return "cannot open checkpoint " + path;
+    if (keep) {
+        struct stat st;
+        if (fstat(ck.fd, &st) != 0 || (size_t)st.st_size != ck.size)
+            return "checkpoint " + path + " does not match the grid size";
+    } else if (ftruncate(ck.fd, ck.size) != 0) {
+        return "cannot resize checkpoint " + path;
+    }
+    void* p = mmap(nullptr, ck.size, PROT_READ | PROT_WRITE, MAP_SHARED, ck.fd, 0);
+    if (p == MAP_FAILED)
+        return "cannot map checkpoint " + path;
+    ck.base = (char*)p;
+    checkpoint_header* h = ck.header();
+    if (keep) {
+        if (std::memcmp(h->magic, CHECKPOINT_MAGIC, 8) != 0 || h->m != m)
+            return "checkpoint " + path + " does not match the grid size";
+        if (h->iters[0] < 0 && h->iters[1] < 0)
+            return "checkpoint " + path + " holds no saved state";
+        ck.next_slot = checkpoint_latest(ck) ^ 1;
+    } else {
+        std::memcpy(h->magic, CHECKPOINT_MAGIC, 8);
+        h->m = m;
+        h->iters[0] = h->iters[1] = -1;
+        msync(ck.base, CHECKPOINT_DATA, MS_SYNC);
+    }
+    return "";
+}
+
+// фоновая запись grid в очередной слот. Поток копирует сетку в отображение
+// и выставляет copied, после чего grid снова можно менять; сброс на диск
+// и обновление заголовка идут уже без участия решателя
+inline void checkpoint_save_async(checkpoint_file& ck, const double* grid, int iter, double error) {
+    if (ck.writer.joinable())
+        ck.writer.join();
+    ck.copied = false;
+    ck.finished = false;
+    int s = ck.next_slot;
+    ck.next_slot ^= 1;
+    ck.writer = std::thread([&ck, grid, iter, error, s]() {
+        size_t bytes = (size_t)ck.m * ck.m * sizeof(double);
+        checkpoint_header* h = ck.header();
+        std::memcpy(ck.slot(s), grid, bytes);
+        ck.copied = true;
+        msync(ck.slot(s), bytes, MS_SYNC);
+        h->errors[s] = error;
+        h->iters[s] = iter;
+        h->iters[s ^ 1] = -1;
+        msync(ck.base, CHECKPOINT_DATA, MS_SYNC);
+        ck.finished = true;
+    });
+}
+
+// предыдущая точка еще сбрасывается на диск - новую лучше пропустить
+inline bool checkpoint_busy(checkpoint_file& ck) {
+    return !ck.finished;
+}
+
+// дождаться, пока писатель отпустит сетку
+inline void checkpoint_wait_copy(checkpoint_file& ck) {
+    while (!ck.copied)
+        std::this_thread::yield();
+}
+
+inline void checkpoint_close(checkpoint_file& ck) {
+    if (ck.writer.joinable())
+        ck.writer.join();
+    if (ck.base != nullptr)
+        munmap(ck.base, ck.size);
+    if (ck.fd >= 0)
+        close(ck.fd);
+    ck.base = nullptr;
+    ck.fd = -1;
+}
@@ -3,18 +3,73 @@
 #include <iostream>
 #include <iomanip>
 #include <chrono>
+#include <cstring>
+#include <omp.h>
+#include <string>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <atomic>
+#include <thread>
 #include <boost/program_options.hpp>
+#include "stencil_simd.h"
+#include "dst.h"
+#include "checkpoint.h"
+#include "snapshot.h"
+#include "solution_cache.h"
+#include "telemetry.h"
+#include "heat_solver.h"
+#include "numa_place.h"
+#include "tridiag.h"
+#include "domain_mask.h"
 
 
 // using vd = std::vector<double>;
 using vd = double*;
 int n, max_iters;
 double eps;
+std::string method; // jacobi, sor, mg, cg, dst, adi
+double adi_dt; // adi time step
+std::string precond; // cg preconditioner: none, jacobi, ssor
+bool inplace; // single-grid Jacobi with rolling row buffers
+bool pipelined; // one parallel region, error check lagged by one sweep
+bool subdomains; // thread-private padded row bands with halo exchange
+int check_every; // sweeps between error checks, 0 - adaptive
+int checks_done;
+std::string storage; // grid storage for jacobi: double, float, bf16
+int lowp_iters; // sweeps done in the low precision storage
+std::string checkpoint_path; // periodic checkpoints of the jacobi grid, empty - off
+int checkpoint_every;
+bool restart; // resume from checkpoint_path
+std::string snapshot_path; // binary frames of intermediate grids, empty - off
+int snapshot_every;
+std::string batch_path; // file with corner temperatures, one problem per line
+std::string cache_dir; // converged solutions keyed by n and boundary, empty - off
+bool warm_start; // start from the closest cached solution
+bool generic; // never use the kernels specialized for fixed n
+bool numa_bind_pages; // pin row bands of the grids to the NUMA node of their thread
+int graph_steps; // sweeps per task graph replay, 0 - off
+std::string mask_path; // domain mask for jacobi, empty - the whole square
+int tblock_steps, tile_size; // temporal blocking: steps per tile (<= 1 - plain sweep) and tile edge
+stencil_row_fn stencil_row; // SIMD row kernel chosen at startup, nullptr - OpenACC loop
+std::string simd_isa; // --simd as given: auto, avx512, avx2, scalar or off
+const char* stencil_name = "acc";
+std::string telemetry_path; // per-iteration telemetry dump (.json or .csv), empty - off
+telemetry* telem;
 
 #define ind(i, j) ((i) * n + (j))
+#define cind(i, j, m) ((i) * (m) + (j))
 #define max(a, b) ((a) > (b) ? (a) : (b))
 #define abs(a) ((a) < 0 ? (0-(a)) : (a))
 
+// граничные условия задачи: температуры углов,
+// вдоль сторон линейная интерполяция
+struct boundary_spec {
+    double tl, tr, bl, br;
+};
+boundary_spec corners = {10, 20, 20, 30};
+
 vd interpolation(double start, double end) {
     vd res = (vd)malloc(n * sizeof(double));
     double curr = start;
@@ -25,21 +80,33 @@ vd interpolation(double start, double end) {
     }
     return res;
 }
+// строки выравниваются на кэш-линию, если n кратно 8 (см. stencil_row_fixed),
+// страницы касаются первыми потоки, которые потом считают эти строки
 vd init_grid() {
-    vd res = (vd)calloc(n * n, sizeof(double));
-    //  10 ... 20
-    // ... ... ...
-    //  20 ... 30
-    vd inter = interpolation(10, 20);
-    for (int i = 0; i < n; i++) {
+    size_t bytes = ((size_t)n * n * sizeof(double) + STENCIL_ALIGN - 1) / STENCIL_ALIGN * STENCIL_ALIGN;
+    void* mem = nullptr;
+    if (posix_memalign(&mem, STENCIL_ALIGN, bytes) != 0)
+        return nullptr;
+    vd res = (vd)mem;
+    numa_first_touch(res, n, bytes, 0, numa_bind_pages);
+    //  tl ... tr       10 ... 20
+    // ... ... ...  по умолчанию ... ... ...
+    //  bl ... br       20 ... 30
+    vd inter = interpolation(corners.tl, corners.tr);
+    for (int i = 0; i < n; i++)
         res[ind(0, i)] = inter[i];
+    free(inter);
+    inter = interpolation(corners.tl, corners.bl);
+    for (int i = 0; i < n; i++)
         res[ind(i, 0)] = inter[i];
-    }
-    inter = interpolation(20, 30);
-    for (int i = 0; i < n; i++) {
+    free(inter);
+    inter = interpolation(corners.tr, corners.br);
+    for (int i = 0; i < n; i++)
         res[ind(i, n - 1)] = inter[i];
+    free(inter);
+    inter = interpolation(corners.bl, corners.br);
+    for (int i = 0; i < n; i++)
         res[ind(n - 1, i)] = inter[i];
-    }
     free(inter);
     return res;
 }
@@ -48,8 +115,8 @@ void print_matrix(vd mat, std::ostream& out=std::cout) {
     out << "Matrix " << n << "x" << n << "\n";
     for (int i = 0; i < n; i++) {
         for (int j = 0; j < n; j++) {
-            std::cout << std::fixed << std::setprecision(2) 
-                      << std::setw(6) << mat[ind(i, j)] << " ";
+            out << std::fixed << std::setprecision(2)
+                << std::setw(6) << mat[ind(i, j)] << " ";
         }
         out << "\n";
     }
@@ -65,6 +132,7 @@ std::pair<int, double> method_Jacobi(vd A, vd Anew) {
 
     while(error > eps && iter < max_iters) {
         error = 0;
+        TELEMETRY(telem, telemetry_iter_begin(*telem));
 
         #pragma acc parallel loop collapse(2) reduction(max:error) present(A, Anew)
         for (int i = 1; i < sub_n; i++) {
@@ -77,6 +145,7 @@ std::pair<int, double> method_Jacobi(vd A, vd Anew) {
         std::swap(A, Anew);
 
         iter++;
+        TELEMETRY(telem, telemetry_iter_end(*telem, iter, error));
     }
 
     #pragma acc update self(A[0:(n * n)])
@@ -85,6 +154,1524 @@ std::pair<int, double> method_Jacobi(vd A, vd Anew) {
     return std::make_pair(iter, error);
 }
 
+// тот же проход, но строки считаются векторным ядром stencil_row
+std::pair<int, double> method_Jacobi_simd(vd A, vd Anew) {
+    int iter = 0;
+    double error = eps + 1;
+    int sub_n = n - 1;
+
+    while (error > eps && iter < max_iters) {
+        error = 0;
+        TELEMETRY(telem, telemetry_iter_begin(*telem));
+
+        #pragma omp parallel reduction(max:error)
+        {
+            TELEMETRY(telem, telemetry_thread_begin(*telem));
+            #pragma omp for schedule(static) nowait
+            for (int i = 1; i < sub_n; i++) {
+                double row_error = stencil_row(A + ind(i - 1, 0), A + ind(i, 0), A + ind(i + 1, 0),
+                                               Anew + ind(i, 0), n);
+                error = max(error, row_error);
+            }
+            TELEMETRY(telem, telemetry_thread_end(*telem));
+        }
+        std::swap(A, Anew);
+
+        iter++;
+        TELEMETRY(telem, telemetry_iter_end(*telem, iter, error));
+    }
+
+    return std::make_pair(iter, error);
+}
+
+// строка шаблона без подсчета ошибки: цикл без редукции компилятор
+// векторизует сам, копии под AVX-512/AVX2 выбираются при загрузке
+STENCIL_CLONES
+void jacobi_row_update(const double* up, const double* mid, const double* down, double* out, int m) {
+    for (int j = 1; j < m - 1; j++)
+        out[j] = (up[j] + down[j] + mid[j - 1] + mid[j + 1]) * 0.25;
+}
+
+// проход Якоби в двух вариантах: с подсчетом ошибки и без него
+template <bool check>
+double jacobi_sweep(vd A, vd Anew) {
+    double error = 0;
+    int sub_n = n - 1;
+    stencil_row_fn row_kernel = stencil_row != nullptr ? stencil_row : stencil_row_scalar;
+
+    #pragma omp parallel for reduction(max:error) schedule(static)
+    for (int i = 1; i < sub_n; i++) {
+        if (check) {
+            double row_error = row_kernel(A + ind(i - 1, 0), A + ind(i, 0), A + ind(i + 1, 0),
+                                          Anew + ind(i, 0), n);
+            error = max(error, row_error);
+        } else {
+            jacobi_row_update(A + ind(i - 1, 0), A + ind(i, 0), A + ind(i + 1, 0), Anew + ind(i, 0), n);
+        }
+    }
+    return error;
+}
+
+#define CHECK_MAX_GAP 1024
+
+// через сколько проходов следующая проверка. Ошибка Якоби асимптотически
+// убывает геометрически, e_k ~ C rho^k; rho берется по двум последним
+// проверкам, и до предсказанного достижения eps делается половина пути.
+// Оценка по ранним проверкам оптимистична (высокие гармоники гаснут быстрее),
+// поэтому половина шага не перелетает точку сходимости, а к ней
+// проверки сгущаются сами
+int next_check_gap(int iter, double error, int& last_iter, double& last_error, int gap) {
+    if (check_every > 0)
+        return check_every;
+    if (last_iter > 0 && error > eps && error < last_error) {
+        double log_rate = std::log(error / last_error) / (iter - last_iter);
+        double need = std::log(eps / error) / log_rate;
+        gap = need < 2 * CHECK_MAX_GAP ? (int)std::ceil(need / 2) : CHECK_MAX_GAP;
+    } else {
+        gap = 2 * gap < CHECK_MAX_GAP ? 2 * gap : CHECK_MAX_GAP;
+    }
+    last_iter = iter;
+    last_error = error;
+    return gap > 1 ? gap : 1;
+}
+
+// Якоби с проверкой сходимости не на каждом проходе. Итерации считаются
+// до первой проверки с error <= eps, поэтому могут превышать
+// method_Jacobi на несколько проходов; сами значения сетки те же
+std::pair<int, double> method_Jacobi_checked(vd A, vd Anew) {
+    int iter = 0;
+    double error = eps + 1;
+    int gap = 1, last_iter = 0;
+    double last_error = 0;
+    checks_done = 0;
+
+    while (error > eps && iter < max_iters) {
+        int next = iter + gap < max_iters ? iter + gap : max_iters;
+        for (; iter < next - 1; iter++) {
+            jacobi_sweep<false>(A, Anew);
+            std::swap(A, Anew);
+        }
+        error = jacobi_sweep<true>(A, Anew);
+        std::swap(A, Anew);
+        iter++;
+        checks_done++;
+        gap = next_check_gap(iter, error, last_iter, last_error, gap);
+    }
+
+    return std::make_pair(iter, error);
+}
+
+// Якоби на одной сетке: каждый поток идет по своей полосе строк и перед
+// перезаписью строки i сохраняет ее старое значение в кольцевой буфер из двух
+// строк, оно нужно строке i + 1. Старые крайние строки полос копируются
+// в общие буферы до прохода, так что соседи читают их неиспорченными.
+// Порядок сложения тот же, что у method_Jacobi, итерации и error совпадают
+std::pair<int, double> method_Jacobi_inplace(vd A) {
+    int iter = 0;
+    double error = eps + 1;
+    int sub_n = n - 1;
+    stencil_row_fn row_kernel = stencil_row != nullptr ? stencil_row : stencil_row_scalar;
+    // полос не больше, чем строк, чтобы у каждого потока была хотя бы одна
+    int threads = omp_get_max_threads() < n - 2 ? omp_get_max_threads() : n - 2;
+    // на поток: две строки кольцевого буфера, старые первая и последняя строки полосы
+    std::vector<double> lines((size_t)threads * 4 * n);
+
+    while (error > eps && iter < max_iters) {
+        error = 0;
+
+        #pragma omp parallel reduction(max:error) num_threads(threads)
+        {
+            int t = omp_get_thread_num(), T = omp_get_num_threads();
+            int rows = sub_n - 1;
+            int r0 = 1 + (int)((long long)rows * t / T), r1 = 1 + (int)((long long)rows * (t + 1) / T);
+            double* ring[2] = {&lines[(size_t)(4 * t) * n], &lines[(size_t)(4 * t + 1) * n]};
+            double* top = &lines[(size_t)(4 * t + 2) * n];
+            double* bottom = &lines[(size_t)(4 * t + 3) * n];
+            std::memcpy(top, A + ind(r0, 0), n * sizeof(double));
+            std::memcpy(bottom, A + ind(r1 - 1, 0), n * sizeof(double));
+            #pragma omp barrier
+            // старая строка над полосой: граница или последняя строка соседа сверху
+            const double* up = r0 == 1 ? A + ind(0, 0) : &lines[(size_t)(4 * t - 1) * n];
+            int cur = 0;
+            for (int i = r0; i < r1; i++) {
+                double* mid = ring[cur];
+                std::memcpy(mid, A + ind(i, 0), n * sizeof(double));
+                const double* down = A + ind(i + 1, 0);
+                if (i + 1 == r1 && r1 < sub_n)
+                    down = &lines[(size_t)(4 * (t + 1) + 2) * n];
+                double row_error = row_kernel(up, mid, down, A + ind(i, 0), n);
+                error = max(error, row_error);
+                up = mid;
+                cur ^= 1;
+            }
+        }
+
+        iter++;
+    }
+
+    return std::make_pair(iter, error);
+}
+
+#define PAD 8 // double на кэш-линию, чтобы частичные ошибки потоков не делили линию
+
+// Якоби в одной параллельной области на весь счет, без fork/join и reduction
+// на каждой итерации. Поток пишет максимум по своим строкам в свою ячейку
+// слота it % 2, а итоговую ошибку итерации it каждый поток собирает сам уже
+// после прохода it + 1, пока соседние ячейки давно записаны; остается один
+// барьер на итерацию, тот, что нужен самому Якоби.
+// При остановке на it проход it + 1 лишний, но он писал в другой буфер,
+// состояние it не тронуто: итерации, error и сетка как у method_Jacobi
+std::pair<int, double> method_Jacobi_pipelined(vd A, vd Anew) {
+    if (max_iters <= 0)
+        return std::make_pair(0, eps + 1);
+    int sub_n = n - 1;
+    stencil_row_fn row_kernel = stencil_row != nullptr ? stencil_row : stencil_row_scalar;
+    int threads = omp_get_max_threads();
+    std::vector<double> partial(2 * threads * PAD, 0.0);
+    int result_iter = 0;
+    double result_error = 0;
+
+    #pragma omp parallel num_threads(threads)
+    {
+        int t = omp_get_thread_num(), T = omp_get_num_threads();
+        int rows = sub_n - 1;
+        int r0 = 1 + (int)((long long)rows * t / T), r1 = 1 + (int)((long long)rows * (t + 1) / T);
+        vd src = A, dst = Anew;
+        int it = 0; // завершенные проходы
+
+        while (true) {
+            double local = 0;
+            for (int i = r0; i < r1; i++) {
+                double row_error = row_kernel(src + ind(i - 1, 0), src + ind(i, 0), src + ind(i + 1, 0),
+                                              dst + ind(i, 0), n);
+                local = max(local, row_error);
+            }
+            partial[((it + 1) % 2 * T + t) * PAD] = local;
+
+            // отложенная проверка итерации it: ее слот дописан до прошлого барьера
+            bool stop = false;
+            if (it >= 1) {
+                double e = 0;
+                for (int k = 0; k < T; k++)
+                    e = max(e, partial[(it % 2 * T + k) * PAD]);
+                if (e <= eps) {
+                    stop = true;
+                    if (t == 0) {
+                        result_iter = it;
+                        result_error = e;
+                    }
+                }
+            }
+            #pragma omp barrier
+            if (stop)
+                break;
+            it++;
+            std::swap(src, dst);
+            if (it == max_iters) {
+                if (t == 0) {
+                    double e = 0;
+                    for (int k = 0; k < T; k++)
+                        e = max(e, partial[(it % 2 * T + k) * PAD]);
+                    result_iter = it;
+                    result_error = e;
+                }
+                break;
+            }
+        }
+    }
+
+    return std::make_pair(result_iter, result_error);
+}
+
+// Якоби на приватных подобластях: каждый поток сам выделяет (и первым
+// касается) свою полосу строк с двумя теневыми строками, шаг строки
+// дополнен до кэш-линии. Общих строк между потоками нет: после прохода
+// поток выкладывает свои крайние строки в маленькие общие буферы, после
+// барьера забирает строки соседей в теневые. Буферы и ячейки ошибок
+// чередуются по четности итерации, поэтому барьер на итерацию один.
+// Итерации, error и сетка совпадают с method_Jacobi. Если хоть одному
+// потоку не хватило памяти, все выходят до счета, итераций -1
+std::pair<int, double> method_Jacobi_private(vd A, vd Anew) {
+    if (max_iters <= 0)
+        return std::make_pair(0, eps + 1);
+    int rows = n - 2;
+    int max_threads = omp_get_max_threads() < rows ? omp_get_max_threads() : rows;
+    int ld = (n + PAD - 1) / PAD * PAD; // шаг строки, кратный кэш-линии
+    stencil_row_fn row_kernel = stencil_row != nullptr ? stencil_row : stencil_row_scalar;
+    // halo[parity][t][0] - верхняя строка потока t, [1] - нижняя
+    std::vector<double*> halo;
+    std::vector<double> partial;
+    int result_iter = 0;
+    double result_error = 0;
+    std::atomic<bool> failed{false};
+
+    #pragma omp parallel num_threads(max_threads)
+    {
+        // команда бывает меньше запрошенной (OMP_THREAD_LIMIT, OMP_DYNAMIC),
+        // полосы и буферы делятся на столько потоков, сколько пришло
+        int t = omp_get_thread_num(), threads = omp_get_num_threads();
+        #pragma omp single
+        {
+            halo.assign(2 * threads * 2, nullptr);
+            partial.assign(2 * threads * PAD, 0.0);
+        }
+        int r0 = 1 + (int)((long long)rows * t / threads), r1 = 1 + (int)((long long)rows * (t + 1) / threads);
+        int h = r1 - r0;
+        // локальная строка k - глобальная r0 - 1 + k, строки 0 и h + 1 теневые
+        void* mem = nullptr;
+        size_t bytes = 2 * (size_t)(h + 2) * ld * sizeof(double);
+        if (posix_memalign(&mem, STENCIL_ALIGN, bytes) != 0) {
+            mem = nullptr;
+            failed = true;
+        }
+        double* cur = (double*)mem;
+        double* nxt = cur + (size_t)(h + 2) * ld;
+        for (int k = 0; k < h + 2 && mem != nullptr; k++) {
+            std::memcpy(cur + (size_t)k * ld, A + ind(r0 - 1 + k, 0), n * sizeof(double));
+            std::memcpy(nxt + (size_t)k * ld, A + ind(r0 - 1 + k, 0), n * sizeof(double));
+        }
+        for (int p = 0; p < 2; p++) {
+            for (int side = 0; side < 2; side++) {
+                void* buf = nullptr;
+                if (posix_memalign(&buf, STENCIL_ALIGN, (size_t)ld * sizeof(double)) != 0) {
+                    buf = nullptr;
+                    failed = true;
+                }
+                halo[(p * threads + t) * 2 + side] = (double*)buf;
+            }
+        }
+        #pragma omp barrier
+
+        int it = 0;
+        while (!failed) {
+            double local = 0;
+            for (int k = 1; k <= h; k++) {
+                double row_error = row_kernel(cur + (size_t)(k - 1) * ld, cur + (size_t)k * ld,
+                                              cur + (size_t)(k + 1) * ld, nxt + (size_t)k * ld, n);
+                local = max(local, row_error);
+            }
+            it++;
+            int p = it % 2;
+            std::memcpy(halo[(p * threads + t) * 2], nxt + ld, n * sizeof(double));
+            std::memcpy(halo[(p * threads + t) * 2 + 1], nxt + (size_t)h * ld, n * sizeof(double));
+            partial[(p * threads + t) * PAD] = local;
+            #pragma omp barrier
+            if (t > 0)
+                std::memcpy(nxt, halo[(p * threads + t - 1) * 2 + 1], n * sizeof(double));
+            if (t < threads - 1)
+                std::memcpy(nxt + (size_t)(h + 1) * ld, halo[(p * threads + t + 1) * 2], n * sizeof(double));
+            double e = 0;
+            for (int k = 0; k < threads; k++)
+                e = max(e, partial[(p * threads + k) * PAD]);
+            std::swap(cur, nxt);
+            if (e <= eps || it == max_iters) {
+                if (t == 0) {
+                    result_iter = it;
+                    result_error = e;
+                }
+                break;
+            }
+        }
+
+        // полоса возвращается туда, где ее оставил бы обычный проход
+        vd out = it % 2 == 0 ? A : Anew;
+        for (int k = 1; k <= h && !failed; k++)
+            std::memcpy(out + ind(r0 - 1 + k, 0), cur + (size_t)k * ld, n * sizeof(double));
+        free(mem);
+        #pragma omp barrier
+        free(halo[t * 2]);
+        free(halo[t * 2 + 1]);
+        free(halo[(threads + t) * 2]);
+        free(halo[(threads + t) * 2 + 1]);
+    }
+
+    if (failed)
+        return std::make_pair(-1, eps + 1);
+    return std::make_pair(result_iter, result_error);
+}
+
+// один тайл продвигается на steps итераций в приватном буфере:
+// берется тайл с ореолом шириной steps из src, на каждом шаге валидная
+// область сужается на 1, в dst пишется только сам тайл (после steps шагов).
+// Строки считаются векторными ядрами: по своим ячейкам row_kernel вместе
+// с ошибкой, по ореолу jacobi_row_update без нее.
+// errs[t] - максимум |A_{t+1} - A_t| по ячейкам тайла
+void jacobi_tile(const double* src, double* dst, int i0, int i1, int j0, int j1,
+                 int steps, double* buf0, double* buf1, double* errs) {
+    int sub_n = n - 1;
+    stencil_row_fn row_kernel = stencil_row != nullptr ? stencil_row : stencil_row_scalar;
+    int bi0 = max(i0 - steps, 0), bi1 = i1 + steps < n ? i1 + steps : n;
+    int bj0 = max(j0 - steps, 0), bj1 = j1 + steps < n ? j1 + steps : n;
+    int w = bj1 - bj0;
+    #define tind(i, j) (((i) - bi0) * w + ((j) - bj0))
+
+    for (int i = bi0; i < bi1; i++)
+        std::memcpy(buf0 + tind(i, bj0), src + ind(i, bj0), w * sizeof(double));
+    // во второй буфер нужна только граница сетки: остальное, что читается
+    // на шаге t + 1, записано на шаге t
+    for (int i = bi0; i < bi1; i++) {
+        if (i == 0 || i == sub_n) {
+            std::memcpy(buf1 + tind(i, bj0), buf0 + tind(i, bj0), w * sizeof(double));
+            continue;
+        }
+        if (bj0 == 0)
+            buf1[tind(i, 0)] = buf0[tind(i, 0)];
+        if (bj1 == n)
+            buf1[tind(i, sub_n)] = buf0[tind(i, sub_n)];
+    }
+    double *cur = buf0, *nxt = buf1;
+    for (int t = 0; t < steps; t++) {
+        // после шага t значения верны на [i0 - (steps - t - 1), i1 + (steps - t - 1))
+        int h = steps - t - 1;
+        int li0 = max(i0 - h, 1), li1 = i1 + h < sub_n ? i1 + h : sub_n;
+        int lj0 = max(j0 - h, 1), lj1 = j1 + h < sub_n ? j1 + h : sub_n;
+        int ej0 = max(j0, lj0), ej1 = j1 < lj1 ? j1 : lj1;
+        double error = 0;
+        for (int i = li0; i < li1; i++) {
+            // ядра считают out[1 .. m-2], поэтому указатели сдвинуты на j - 1
+            const double* up = cur + tind(i - 1, 0) - 1;
+            const double* mid = cur + tind(i, 0) - 1;
+            const double* down = cur + tind(i + 1, 0) - 1;
+            double* out = nxt + tind(i, 0) - 1;
+            // ошибка считается только по своим ячейкам, ореол просто обновляется
+            if (i < i0 || i >= i1 || ej0 >= ej1) {
+                jacobi_row_update(up + lj0, mid + lj0, down + lj0, out + lj0, lj1 - lj0 + 2);
+                continue;
+            }
+            if (lj0 < ej0)
+                jacobi_row_update(up + lj0, mid + lj0, down + lj0, out + lj0, ej0 - lj0 + 2);
+            double row_error = row_kernel(up + ej0, mid + ej0, down + ej0, out + ej0,
+                                          ej1 - ej0 + 2);
+            error = max(error, row_error);
+            if (ej1 < lj1)
+                jacobi_row_update(up + ej1, mid + ej1, down + ej1, out + ej1, lj1 - ej1 + 2);
+        }
+        errs[t] = error;
+        std::swap(cur, nxt);
+    }
+    int ci0 = max(i0, 1), ci1 = i1 < sub_n ? i1 : sub_n;
+    int cj0 = max(j0, 1), cj1 = j1 < sub_n ? j1 : sub_n;
+    for (int i = ci0; i < ci1; i++)
+        std::memcpy(dst + ind(i, cj0), cur + tind(i, cj0), (cj1 - cj0) * sizeof(double));
+    #undef tind
+}
+
+// все тайлы сетки продвигаются на steps итераций из A в Anew,
+// errs[t] - максимум ошибки шага t по всем тайлам
+void blocked_pass(vd A, vd Anew, int steps, double* errs) {
+    int tiles = (n + tile_size - 1) / tile_size;
+    int buf_edge = tile_size + 2 * steps;
+    for (int t = 0; t < steps; t++)
+        errs[t] = 0;
+
+    #pragma omp parallel
+    {
+        std::vector<double> buf0(buf_edge * buf_edge), buf1(buf_edge * buf_edge);
+        std::vector<double> local_errs(steps, 0.0), tile_errs(steps);
+        #pragma omp for collapse(2) schedule(dynamic)
+        for (int ti = 0; ti < tiles; ti++) {
+            for (int tj = 0; tj < tiles; tj++) {
+                int i0 = ti * tile_size, j0 = tj * tile_size;
+                int i1 = i0 + tile_size < n ? i0 + tile_size : n;
+                int j1 = j0 + tile_size < n ? j0 + tile_size : n;
+                jacobi_tile(A, Anew, i0, i1, j0, j1, steps,
+                            buf0.data(), buf1.data(), tile_errs.data());
+                for (int t = 0; t < steps; t++)
+                    local_errs[t] = max(local_errs[t], tile_errs[t]);
+            }
+        }
+        #pragma omp critical
+        for (int t = 0; t < steps; t++)
+            errs[t] = max(errs[t], local_errs[t]);
+    }
+}
+
+// Якоби с временной блокировкой: каждый тайл делает tblock_steps итераций,
+// пока лежит в кэше, поэтому сетка проходит через память раз в tblock_steps итераций.
+// Ячейки ореола считаются повторно (перекрывающиеся тайлы), результат
+// совпадает побитово с обычным проходом, включая номер итерации остановки
+std::pair<int, double> method_Jacobi_blocked(vd A, vd Anew) {
+    int iter = 0;
+    double error = eps + 1;
+    vd orig_A = A;
+    std::vector<double> errs(tblock_steps), redo_errs(tblock_steps);
+
+    while (error > eps && iter < max_iters) {
+        int steps = tblock_steps < max_iters - iter ? tblock_steps : max_iters - iter;
+        blocked_pass(A, Anew, steps, errs.data());
+
+        // обычный проход остановился бы на первом шаге с error <= eps
+        int done = steps;
+        for (int t = 0; t < steps; t++) {
+            if (errs[t] <= eps) {
+                done = t + 1;
+                break;
+            }
+        }
+        // A не тронута, пересчитываем блок до точки остановки
+        if (done < steps)
+            blocked_pass(A, Anew, done, redo_errs.data());
+        error = errs[done - 1];
+        iter += done;
+        std::swap(A, Anew);
+    }
+
+    // результат там же, где его оставил бы обычный проход (A при четном iter)
+    vd expected = (iter % 2 == 0) ? orig_A : (orig_A == A ? Anew : A);
+    if (expected != A)
+        std::memcpy(expected, A, n * n * sizeof(double));
+
+    return std::make_pair(iter, error);
+}
+
+// Граф задач над тайлами для K проходов, аналог CUDA graph из Lab8.
+// Шаг s тайла зависит только от шага s - 1 его и четырех соседей: они дали
+// ореол G_{s-1} и уже дочитали G_{s-2}, которую шаг s перезаписывает.
+// Граф (тайлы, соседи, раздача потокам) строится один раз и проигрывается
+// постоянной командой потоков; вместо барьера на каждую итерацию поток ждет
+// только счетчики прогресса соседних тайлов, и быстрые тайлы уходят вперед
+struct tile_progress {
+    std::atomic<int> step{0};
+    char pad[64 - sizeof(std::atomic<int>)]; // свой счетчик на кэш-линию
+};
+
+struct tile_graph {
+    int count = 0;
+    std::vector<int> i0, i1, j0, j1;   // обновляемые ячейки тайла
+    std::vector<int> nbr;              // 4 соседа на тайл, -1 - нет
+    std::vector<int> first;            // тайлы потока t: [first[t], first[t + 1])
+    std::vector<tile_progress> progress;
+    std::vector<double> errs;          // errs[(s - 1) * count + tile]
+};
+
+void graph_build(tile_graph& g, int threads, int steps) {
+    int sub_n = n - 1;
+    int tiles = (n - 2 + tile_size - 1) / tile_size;
+    g.count = tiles * tiles;
+    for (int ti = 0; ti < tiles; ti++) {
+        for (int tj = 0; tj < tiles; tj++) {
+            g.i0.push_back(1 + ti * tile_size);
+            g.i1.push_back(1 + (ti + 1) * tile_size < sub_n ? 1 + (ti + 1) * tile_size : sub_n);
+            g.j0.push_back(1 + tj * tile_size);
+            g.j1.push_back(1 + (tj + 1) * tile_size < sub_n ? 1 + (tj + 1) * tile_size : sub_n);
+            g.nbr.push_back(ti > 0 ? (ti - 1) * tiles + tj : -1);
+            g.nbr.push_back(ti < tiles - 1 ? (ti + 1) * tiles + tj : -1);
+            g.nbr.push_back(tj > 0 ? ti * tiles + tj - 1 : -1);
+            g.nbr.push_back(tj < tiles - 1 ? ti * tiles + tj + 1 : -1);
+        }
+    }
+    for (int t = 0; t <= threads; t++)
+        g.first.push_back((int)((long long)g.count * t / threads));
+    g.progress = std::vector<tile_progress>(g.count);
+    g.errs.resize((size_t)steps * g.count);
+}
+
+// шаг одного тайла строками ядра stencil_row: строка тайла с соседними
+// столбцами j0 - 1 и j1 - это строка длины j1 - j0 + 2 для ядра
+double graph_tile_step(const tile_graph& g, int k, const double* src, double* dst) {
+    stencil_row_fn row_kernel = stencil_row != nullptr ? stencil_row : stencil_row_scalar;
+    int j = g.j0[k] - 1, m = g.j1[k] - g.j0[k] + 2;
+    double error = 0;
+    for (int i = g.i0[k]; i < g.i1[k]; i++) {
+        double row_error = row_kernel(src + ind(i - 1, j), src + ind(i, j), src + ind(i + 1, j), dst + ind(i, j), m);
+        error = max(error, row_error);
+    }
+    return error;
+}
+
+// проигрывание графа потоком t: steps шагов от G_0 в A, шаг s пишет
+// в A при четном s и в Anew при нечетном. Прогресс тайлов должен быть
+// обнулен, и все потоки должны это видеть (барьер до вызова)
+void graph_replay(tile_graph& g, int t, int steps, vd A, vd Anew) {
+    int begin = g.first[t], end = g.first[t + 1];
+    std::vector<int> next(end - begin, 1);
+    long long remaining = (long long)(end - begin) * steps;
+    while (remaining > 0) {
+        bool moved = false;
+        for (int k = begin; k < end; k++) {
+            // тайл идет вперед, пока соседи не отстали
+            while (next[k - begin] <= steps) {
+                int s = next[k - begin];
+                bool ready = true;
+                for (int d = 0; d < 4 && ready; d++) {
+                    int nb = g.nbr[4 * k + d];
+                    ready = nb < 0 || g.progress[nb].step.load(std::memory_order_acquire) >= s - 1;
+                }
+                if (!ready)
+                    break;
+                const double* src = s % 2 == 1 ? A : Anew;
+                double* dst = s % 2 == 1 ? Anew : A;
+                g.errs[(size_t)(s - 1) * g.count + k] = graph_tile_step(g, k, src, dst);
+                g.progress[k].step.store(s, std::memory_order_release);
+                next[k - begin]++;
+                remaining--;
+                moved = true;
+            }
+        }
+        if (!moved)
+            std::this_thread::yield();
+    }
+}
+
+// нужно ли сохранить сетку перед блоком из steps проходов: откат возможен,
+// только если сходимость наступит раньше шага steps - 1. Ошибка прошлого
+// блока падала с first до last за prev_steps проходов; с запасом считаем,
+// что дальше она падает вдвое быстрее (в логарифме)
+bool graph_may_stop(double first, double last, int prev_steps, int steps) {
+    if (steps <= 2)
+        return false;
+    if (prev_steps < 2 || first <= 0)
+        return true;
+    double rate = std::pow(last / first, 1.0 / (prev_steps - 1));
+    return last * std::pow(rate, 2.0 * steps) <= eps;
+}
+
+// Якоби через граф задач по graph_steps проходов. Если сходимость наступила
+// внутри блока, нужна сетка G_done: при done = steps - 1 она еще лежит в своем
+// буфере, иначе берется последняя сохраненная сетка и пересчитывается до
+// точки остановки. Сетка сохраняется только перед блоками, где по скорости
+// падения ошибки возможен откат (graph_may_stop), и перед первым; если
+// прогноз ошибся, пересчет просто идет от более ранней сохраненной сетки.
+// Итерации, error и сетка совпадают с обычным проходом
+std::pair<int, double> method_Jacobi_graph(vd A, vd Anew) {
+    int iter = 0;
+    double error = eps + 1;
+    vd orig_A = A;
+    tile_graph g;
+    std::vector<double> saved;
+    int saved_iter = 0;
+    double first_error = 0, last_error = 0;
+    int steps = 0, prev_steps = 0, done = 0, redo = 0;
+    #pragma omp parallel
+    {
+        // тайлы делятся на потоки команды, а она бывает меньше
+        // omp_get_max_threads (OMP_THREAD_LIMIT, OMP_DYNAMIC)
+        #pragma omp single
+        graph_build(g, omp_get_num_threads(), graph_steps);
+        int t = omp_get_thread_num();
+        while (error > eps && iter < max_iters) {
+            #pragma omp single
+            {
+                steps = graph_steps < max_iters - iter ? graph_steps : max_iters - iter;
+                if (saved.empty() || graph_may_stop(first_error, last_error, prev_steps, steps)) {
+                    saved.resize((size_t)n * n);
+                    std::memcpy(saved.data(), A, (size_t)n * n * sizeof(double));
+                    saved_iter = iter;
+                }
+                for (int k = 0; k < g.count; k++)
+                    g.progress[k].step.store(0, std::memory_order_relaxed);
+            }
+            graph_replay(g, t, steps, A, Anew);
+            #pragma omp barrier
+            #pragma omp single
+            {
+                // обычный проход остановился бы на первом шаге с error <= eps
+                done = steps;
+                for (int s = 1; s <= steps; s++) {
+                    double e = 0;
+                    for (int k = 0; k < g.count; k++)
+                        e = max(e, g.errs[(size_t)(s - 1) * g.count + k]);
+                    if (s == 1)
+                        first_error = e;
+                    if (e <= eps || s == steps) {
+                        done = s;
+                        error = e;
+                        break;
+                    }
+                }
+                last_error = error;
+                prev_steps = done;
+                redo = 0;
+                if (done < steps - 1) {
+                    std::memcpy(A, saved.data(), (size_t)n * n * sizeof(double));
+                    redo = iter + done - saved_iter;
+                }
+            }
+            // пересчет от сохраненной сетки кусками не длиннее графа
+            for (int left = redo; left > 0;) {
+                int chunk = left < graph_steps ? left : graph_steps;
+                #pragma omp single
+                for (int k = 0; k < g.count; k++)
+                    g.progress[k].step.store(0, std::memory_order_relaxed);
+                graph_replay(g, t, chunk, A, Anew);
+                #pragma omp barrier
+                #pragma omp single
+                if (chunk % 2 == 1)
+                    std::swap(A, Anew);
+                left -= chunk;
+            }
+            #pragma omp single
+            {
+                iter += done;
+                if (redo == 0 && done % 2 == 1)
+                    std::swap(A, Anew);
+            }
+        }
+    }
+    // результат там же, где его оставил бы обычный проход (A при четном iter)
+    vd expected = (iter % 2 == 0) ? orig_A : (orig_A == A ? Anew : A);
+    if (expected != A)
+        std::memcpy(expected, A, n * n * sizeof(double));
+    return std::make_pair(iter, error);
+}
+
+// Якоби на области по маске (domain_mask.h): длинные отрезки строк считает
+// ядро stencil_row, упакованные ячейки - mask_packed_sweep порциями по
+// MASK_PACK. Дыры и включения проход не трогает. Как и method_Jacobi,
+// после нечетного числа итераций решение остается в Anew
+#define MASK_PACK 256
+std::pair<int, double> method_Jacobi_masked(vd A, vd Anew, const domain_mask& dm) {
+    int iter = 0;
+    double error = eps + 1;
+    stencil_row_fn row_kernel = stencil_row != nullptr ? stencil_row : stencil_row_scalar;
+    int runs = (int)dm.runs.size(), packed = (int)dm.cell.size();
+
+    while (error > eps && iter < max_iters) {
+        error = 0;
+
+        #pragma omp parallel reduction(max:error)
+        {
+            #pragma omp for schedule(static) nowait
+            for (int r = 0; r < runs; r++) {
+                const mask_run& run = dm.runs[r];
+                // ядро считает out[1 .. m-2], поэтому указатели сдвинуты на j0 - 1
+                size_t o = (size_t)run.row * n + run.j0 - 1;
+                double run_error = row_kernel(A + o - n, A + o, A + o + n, Anew + o, run.j1 - run.j0 + 2);
+                error = max(error, run_error);
+            }
+            #pragma omp for schedule(static)
+            for (int c0 = 0; c0 < packed; c0 += MASK_PACK) {
+                double pack_error = mask_packed_sweep(dm, A, Anew, c0, c0 + MASK_PACK < packed ? c0 + MASK_PACK : packed);
+                error = max(error, pack_error);
+            }
+        }
+        std::swap(A, Anew);
+
+        iter++;
+    }
+
+    return std::make_pair(iter, error);
+}
+
+// оптимальный параметр релаксации для задачи Лапласа на квадратной сетке:
+// спектральный радиус Якоби cos(pi / (n - 1)), omega = 2 / (1 + sqrt(1 - rho^2))
+double optimal_omega() {
+    return 2.0 / (1.0 + std::sin(M_PI / (n - 1)));
+}
+
+// красно-черный SOR на месте: сначала ячейки с четной i + j, затем с нечетной,
+// внутри цвета ячейки независимы. error - максимальная поправка за итерацию
+std::pair<int, double> method_SOR(vd A, double omega) {
+    int iter = 0;
+    double error = eps + 1;
+    int sub_n = n - 1;
+
+    while (error > eps && iter < max_iters) {
+        error = 0;
+
+        #pragma omp parallel reduction(max:error)
+        for (int color = 0; color < 2; color++) {
+            #pragma omp for schedule(static)
+            for (int i = 1; i < sub_n; i++) {
+                for (int j = 1 + (i + 1 + color) % 2; j < sub_n; j += 2) {
+                    double gs = (A[ind(i - 1, j)] + A[ind(i + 1, j)] +
+                                 A[ind(i, j - 1)] + A[ind(i, j + 1)]) * 0.25;
+                    double delta = omega * (gs - A[ind(i, j)]);
+                    A[ind(i, j)] += delta;
+                    error = max(error, abs(delta));
+                }
+            }
+        }
+
+        iter++;
+    }
+
+    return std::make_pair(iter, error);
+}
+
+// уровень многосеточного метода: сетка m x m на единичном квадрате.
+// u - решение (на грубых уровнях - поправка), t - второй буфер Якоби,
+// f - правая часть -lap(u) = f, r - невязка
+struct mg_level {
+    int m;
+    double h2;
+    std::vector<double> u, t, f, r;
+};
+
+#define MG_OMEGA 0.8      // демпфирование Якоби как сглаживателя
+#define MG_SMOOTH 2       // итераций сглаживания до и после спуска
+#define MG_COARSEST 5     // размер самой грубой сетки
+#define MG_PAR(m) ((m) > 64) // мелкие уровни считаются в одном потоке
+
+// уровни от n до самой грубой сетки, m -> (m + 2) / 2.
+// При нечетном n - 1 сетки не вложены, операторы перехода это учитывают
+std::vector<mg_level> mg_build() {
+    std::vector<mg_level> levels;
+    int m = n;
+    while (true) {
+        mg_level L;
+        L.m = m;
+        L.h2 = 1.0 / ((double)(m - 1) * (m - 1));
+        L.u.assign(m * m, 0.0);
+        L.t.assign(m * m, 0.0);
+        L.f.assign(m * m, 0.0);
+        L.r.assign(m * m, 0.0);
+        levels.push_back(L);
+        if (m <= MG_COARSEST)
+            break;
+        m = (m + 2) / 2;
+    }
+    return levels;
+}
+
+// граница уровня - линейная выборка из границы сетки A
+void mg_set_boundary(mg_level& L, const double* A) {
+    int m = L.m;
+    double ratio = (double)(n - 1) / (m - 1);
+    for (int k = 0; k < m; k++) {
+        double x = k * ratio;
+        int k0 = (int)x < n - 1 ? (int)x : n - 2;
+        double a = x - k0;
+        double top = (1 - a) * A[ind(0, k0)] + a * A[ind(0, k0 + 1)];
+        double bottom = (1 - a) * A[ind(n - 1, k0)] + a * A[ind(n - 1, k0 + 1)];
+        double left = (1 - a) * A[ind(k0, 0)] + a * A[ind(k0 + 1, 0)];
+        double right = (1 - a) * A[ind(k0, n - 1)] + a * A[ind(k0 + 1, n - 1)];
+        L.u[cind(0, k, m)] = L.t[cind(0, k, m)] = top;
+        L.u[cind(m - 1, k, m)] = L.t[cind(m - 1, k, m)] = bottom;
+        L.u[cind(k, 0, m)] = L.t[cind(k, 0, m)] = left;
+        L.u[cind(k, m - 1, m)] = L.t[cind(k, m - 1, m)] = right;
+    }
+}
+
+// сглаживание: тот же шаблон Якоби с правой частью, демпфированный
+void mg_smooth(mg_level& L, int sweeps) {
+    int m = L.m;
+    for (int s = 0; s < sweeps; s++) {
+        double *u = L.u.data(), *t = L.t.data();
+        const double* f = L.f.data();
+        #pragma omp parallel for if(MG_PAR(m)) schedule(static)
+        for (int i = 1; i < m - 1; i++) {
+            for (int j = 1; j < m - 1; j++) {
+                double jac = (u[cind(i - 1, j, m)] + u[cind(i + 1, j, m)] +
+                              u[cind(i, j - 1, m)] + u[cind(i, j + 1, m)] + L.h2 * f[cind(i, j, m)]) * 0.25;
+                t[cind(i, j, m)] = u[cind(i, j, m)] + MG_OMEGA * (jac - u[cind(i, j, m)]);
+            }
+        }
+        L.u.swap(L.t);
+    }
+}
+
+// r = f + lap(u), граница r нулевая; возвращает max|r|
+double mg_residual(mg_level& L) {
+    int m = L.m;
+    const double *u = L.u.data(), *f = L.f.data();
+    double* r = L.r.data();
+    double inv_h2 = 1.0 / L.h2, res = 0;
+    #pragma omp parallel for if(MG_PAR(m)) reduction(max:res) schedule(static)
+    for (int i = 1; i < m - 1; i++) {
+        for (int j = 1; j < m - 1; j++) {
+            double lap = (u[cind(i - 1, j, m)] + u[cind(i + 1, j, m)] + u[cind(i, j - 1, m)] +
+                          u[cind(i, j + 1, m)] - 4 * u[cind(i, j, m)]) * inv_h2;
+            r[cind(i, j, m)] = f[cind(i, j, m)] + lap;
+            res = max(res, abs(r[cind(i, j, m)]));
+        }
+    }
+    return res;
+}
+
+// ограничение невязки: взвешивание шляпкой шириной в шаг грубой сетки,
+// при вложенных сетках это полное взвешивание 1/4, 1/8, 1/16
+void mg_restrict(const mg_level& F, mg_level& C) {
+    int mf = F.m, mc = C.m;
+    double ratio = (double)(mf - 1) / (mc - 1);
+    const double* r = F.r.data();
+    double* f = C.f.data();
+    #pragma omp parallel for if(MG_PAR(mc)) schedule(static)
+    for (int I = 1; I < mc - 1; I++) {
+        double X = I * ratio;
+        int i0 = (int)std::ceil(X - ratio), i1 = (int)std::floor(X + ratio);
+        for (int J = 1; J < mc - 1; J++) {
+            double Y = J * ratio;
+            int j0 = (int)std::ceil(Y - ratio), j1 = (int)std::floor(Y + ratio);
+            double sum = 0, wsum = 0;
+            for (int i = i0; i <= i1; i++) {
+                double wi = 1 - abs(i - X) / ratio;
+                for (int j = j0; j <= j1; j++) {
+                    double w = wi * (1 - abs(j - Y) / ratio);
+                    sum += w * r[cind(i, j, mf)];
+                    wsum += w;
+                }
+            }
+            f[cind(I, J, mc)] = sum / wsum;
+        }
+    }
+}
+
+// билинейная интерполяция грубой сетки во внутренние узлы мелкой:
+// add - прибавить как поправку, иначе записать как начальное приближение
+void mg_prolong(const mg_level& C, mg_level& F, bool add) {
+    int mf = F.m, mc = C.m;
+    double ratio = (double)(mc - 1) / (mf - 1);
+    const double* c = C.u.data();
+    double* u = F.u.data();
+    #pragma omp parallel for if(MG_PAR(mf)) schedule(static)
+    for (int i = 1; i < mf - 1; i++) {
+        double x = i * ratio;
+        int I = (int)x < mc - 1 ? (int)x : mc - 2;
+        double a = x - I;
+        for (int j = 1; j < mf - 1; j++) {
+            double y = j * ratio;
+            int J = (int)y < mc - 1 ? (int)y : mc - 2;
+            double b = y - J;
+            double v = (1 - a) * ((1 - b) * c[cind(I, J, mc)] + b * c[cind(I, J + 1, mc)]) +
+                       a * ((1 - b) * c[cind(I + 1, J, mc)] + b * c[cind(I + 1, J + 1, mc)]);
+            u[cind(i, j, mf)] = add ? u[cind(i, j, mf)] + v : v;
+        }
+    }
+}
+
+void mg_vcycle(std::vector<mg_level>& levels, size_t l) {
+    mg_level& L = levels[l];
+    if (l + 1 == levels.size()) {
+        mg_smooth(L, 100); // несколько внутренних узлов - просто сглаживаем до сходимости
+        return;
+    }
+    mg_level& C = levels[l + 1];
+    mg_smooth(L, MG_SMOOTH);
+    mg_residual(L);
+    mg_restrict(L, C);
+    std::fill(C.u.begin(), C.u.end(), 0.0);
+    std::fill(C.t.begin(), C.t.end(), 0.0);
+    mg_vcycle(levels, l + 1);
+    mg_prolong(C, L, true);
+    mg_smooth(L, MG_SMOOTH);
+}
+
+// многосеточный метод: полный многосеточный старт (FMG) с самой грубой
+// сетки, затем V-циклы. Итерация - один V-цикл (FMG считается за один),
+// error = max|r| * h^2 / 4 - поправка, которую внес бы следующий шаг Якоби,
+// т.е. та же величина, что проверяет method_Jacobi
+std::pair<int, double> method_multigrid(vd A) {
+    std::vector<mg_level> levels = mg_build();
+    mg_level& fine = levels[0];
+    std::memcpy(fine.u.data(), A, n * n * sizeof(double));
+    std::memcpy(fine.t.data(), A, n * n * sizeof(double));
+
+    size_t last = levels.size() - 1;
+    mg_set_boundary(levels[last], A);
+    mg_smooth(levels[last], 100);
+    for (size_t l = last; l-- > 0;) {
+        if (l > 0)
+            mg_set_boundary(levels[l], A);
+        std::fill(levels[l].f.begin(), levels[l].f.end(), 0.0);
+        mg_prolong(levels[l + 1], levels[l], false);
+        mg_vcycle(levels, l);
+    }
+
+    int iter = 1;
+    double error = mg_residual(fine) * fine.h2 * 0.25;
+    while (error > eps && iter < max_iters) {
+        mg_vcycle(levels, 0);
+        error = mg_residual(fine) * fine.h2 * 0.25;
+        iter++;
+    }
+
+    std::memcpy(A, fine.u.data(), n * n * sizeof(double));
+    return std::make_pair(iter, error);
+}
+
+// предобусловливатель SSOR в красно-черном порядке, z = M^-1 r.
+// Прямой ход: красные y = w(2-w) r / 4, черные добавляют w * сумму красных соседей;
+// обратный ход: черные z = y, красные добавляют w * сумму черных соседей.
+// Внутри цвета узлы независимы, поэтому оба хода параллельны.
+// Возвращает r.z
+double cg_ssor(const double* r, double* z, double omega) {
+    int sub_n = n - 1;
+    double scale = omega * (2 - omega) * 0.25, rz = 0;
+    #pragma omp parallel reduction(+:rz)
+    {
+        #pragma omp for schedule(static)
+        for (int i = 1; i < sub_n; i++)
+            for (int j = 1 + (i + 1) % 2; j < sub_n; j += 2)
+                z[ind(i, j)] = scale * r[ind(i, j)];
+        #pragma omp for schedule(static)
+        for (int i = 1; i < sub_n; i++)
+            for (int j = 1 + i % 2; j < sub_n; j += 2)
+                z[ind(i, j)] = scale * r[ind(i, j)] + omega * 0.25 *
+                    (z[ind(i - 1, j)] + z[ind(i + 1, j)] + z[ind(i, j - 1)] + z[ind(i, j + 1)]);
+        #pragma omp for schedule(static)
+        for (int i = 1; i < sub_n; i++) {
+            for (int j = 1 + (i + 1) % 2; j < sub_n; j += 2) {
+                z[ind(i, j)] += omega * 0.25 *
+                    (z[ind(i - 1, j)] + z[ind(i + 1, j)] + z[ind(i, j - 1)] + z[ind(i, j + 1)]);
+            }
+        }
+        #pragma omp for schedule(static)
+        for (int i = 1; i < sub_n; i++)
+            for (int j = 1; j < sub_n; j++)
+                rz += r[ind(i, j)] * z[ind(i, j)];
+    }
+    return rz;
+}
+
+// z = M^-1 r для выбранного предобусловливателя, возвращает r.z.
+// Диагональ оператора постоянна (4), так что jacobi - это просто масштаб
+double cg_precond(const double* r, double* z, double omega) {
+    if (precond == "ssor")
+        return cg_ssor(r, z, omega);
+    int sub_n = n - 1;
+    double d = precond == "jacobi" ? 0.25 : 1.0, rz = 0;
+    #pragma omp parallel for reduction(+:rz) schedule(static)
+    for (int i = 1; i < sub_n; i++) {
+        for (int j = 1; j < sub_n; j++) {
+            z[ind(i, j)] = d * r[ind(i, j)];
+            rz += r[ind(i, j)] * z[ind(i, j)];
+        }
+    }
+    return rz;
+}
+
+// сопряженные градиенты без сборки матрицы: оператор 4u - (сумма соседей)
+// применяется на лету, граница A уходит в правую часть через начальную невязку.
+// Скалярные произведения совмещены с проходами, которые их порождают.
+// error = max|r| / 4 - поправка, которую внес бы следующий шаг Якоби
+std::pair<int, double> method_CG(vd A) {
+    int sub_n = n - 1;
+    double omega = 1.0; // в красно-черном порядке SSOR с w > 1 только хуже
+    // у векторов направлений граница нулевая
+    std::vector<double> r(n * n, 0.0), z(n * n, 0.0), p(n * n, 0.0), Ap(n * n, 0.0);
+
+    double rmax = 0;
+    #pragma omp parallel for reduction(max:rmax) schedule(static)
+    for (int i = 1; i < sub_n; i++) {
+        for (int j = 1; j < sub_n; j++) {
+            r[ind(i, j)] = A[ind(i - 1, j)] + A[ind(i + 1, j)] + A[ind(i, j - 1)] +
+                           A[ind(i, j + 1)] - 4 * A[ind(i, j)];
+            rmax = max(rmax, abs(r[ind(i, j)]));
+        }
+    }
+    double rz = cg_precond(r.data(), z.data(), omega);
+    std::memcpy(p.data(), z.data(), n * n * sizeof(double));
+
+    int iter = 0;
+    double error = rmax * 0.25;
+    while (error > eps && iter < max_iters) {
+        double pAp = 0;
+        #pragma omp parallel for reduction(+:pAp) schedule(static)
+        for (int i = 1; i < sub_n; i++) {
+            for (int j = 1; j < sub_n; j++) {
+                Ap[ind(i, j)] = 4 * p[ind(i, j)] - (p[ind(i - 1, j)] + p[ind(i + 1, j)] +
+                                                    p[ind(i, j - 1)] + p[ind(i, j + 1)]);
+                pAp += p[ind(i, j)] * Ap[ind(i, j)];
+            }
+        }
+        double alpha = rz / pAp;
+
+        rmax = 0;
+        #pragma omp parallel for reduction(max:rmax) schedule(static)
+        for (int i = 1; i < sub_n; i++) {
+            for (int j = 1; j < sub_n; j++) {
+                A[ind(i, j)] += alpha * p[ind(i, j)];
+                r[ind(i, j)] -= alpha * Ap[ind(i, j)];
+                rmax = max(rmax, abs(r[ind(i, j)]));
+            }
+        }
+        error = rmax * 0.25;
+        iter++;
+        if (error <= eps)
+            break;
+
+        double rz_new = cg_precond(r.data(), z.data(), omega);
+        double beta = rz_new / rz;
+        rz = rz_new;
+        #pragma omp parallel for schedule(static)
+        for (int i = 1; i < sub_n; i++)
+            for (int j = 1; j < sub_n; j++)
+                p[ind(i, j)] = z[ind(i, j)] + beta * p[ind(i, j)];
+    }
+
+    return std::make_pair(iter, error);
+}
+
+// DST-I над каждой строкой матрицы rows x N, строки идут парами
+void dst_rows(const dst_plan& plan, double* x, int rows, int N) {
+    #pragma omp parallel
+    {
+        dst_work w = plan.workspace();
+        #pragma omp for schedule(static)
+        for (int r = 0; r < rows / 2; r++)
+            plan.apply2(x + cind(2 * r, 0, N), x + cind(2 * r + 1, 0, N), w);
+        #pragma omp single
+        if (rows % 2)
+            plan.apply(x + cind(rows - 1, 0, N), w);
+    }
+}
+
+// блочное транспонирование N x N
+void transpose(const double* src, double* dst, int N) {
+    const int B = 32;
+    #pragma omp parallel for collapse(2) schedule(static)
+    for (int ib = 0; ib < N; ib += B) {
+        for (int jb = 0; jb < N; jb += B) {
+            int ie = ib + B < N ? ib + B : N, je = jb + B < N ? jb + B : N;
+            for (int i = ib; i < ie; i++)
+                for (int j = jb; j < je; j++)
+                    dst[cind(j, i, N)] = src[cind(i, j, N)];
+        }
+    }
+}
+
+// прямой решатель: синус-преобразование диагонализует оператор 4u - (сумма соседей)
+// на внутренних N = n - 2 узлах, собственные числа (2 - 2cos(pi k / (N + 1))) + (то же для l).
+// Правая часть - граница из A, решение пишется во внутренность A.
+// Итерация одна, error - та же величина, что у Якоби, для контроля точности
+std::pair<int, double> method_DST(vd A) {
+    int N = n - 2;
+    dst_plan plan(N);
+    std::vector<double> b(N * N), bt(N * N), lam(N);
+    for (int k = 0; k < N; k++)
+        lam[k] = 2 - 2 * std::cos(M_PI * (k + 1) / (N + 1));
+
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < N; i++) {
+        for (int j = 0; j < N; j++) {
+            double v = 0;
+            if (i == 0) v += A[ind(0, j + 1)];
+            if (i == N - 1) v += A[ind(n - 1, j + 1)];
+            if (j == 0) v += A[ind(i + 1, 0)];
+            if (j == N - 1) v += A[ind(i + 1, n - 1)];
+            b[cind(i, j, N)] = v;
+        }
+    }
+
+    dst_rows(plan, b.data(), N, N);
+    transpose(b.data(), bt.data(), N);
+    dst_rows(plan, bt.data(), N, N);
+    // спектр симметричен по k, l, так что делить можно в транспонированном виде
+    double scale = 4.0 / ((double)(N + 1) * (N + 1));
+    #pragma omp parallel for schedule(static)
+    for (int k = 0; k < N; k++)
+        for (int l = 0; l < N; l++)
+            bt[cind(k, l, N)] *= scale / (lam[k] + lam[l]);
+    dst_rows(plan, bt.data(), N, N);
+    transpose(bt.data(), b.data(), N);
+    dst_rows(plan, b.data(), N, N);
+
+    int sub_n = n - 1;
+    #pragma omp parallel for schedule(static)
+    for (int i = 1; i < sub_n; i++)
+        std::memcpy(A + ind(i, 1), b.data() + cind(i - 1, 0, N), N * sizeof(double));
+
+    double error = 0;
+    #pragma omp parallel for reduction(max:error) schedule(static)
+    for (int i = 1; i < sub_n; i++) {
+        for (int j = 1; j < sub_n; j++) {
+            double jac = (A[ind(i - 1, j)] + A[ind(i + 1, j)] +
+                          A[ind(i, j - 1)] + A[ind(i, j + 1)]) * 0.25;
+            error = max(error, abs(jac - A[ind(i, j)]));
+        }
+    }
+    return std::make_pair(1, error);
+}
+
+// Нестационарная задача u_t = u_xx + u_yy (шаг сетки 1) схемой переменных
+// направлений Писмена - Рэкфорда: полушаг dt/2 неявно по j и явно по i,
+// затем наоборот. Схема устойчива при любом dt, явному Якоби же нужно
+// dt <= 1/4, поэтому длинные процессы считаются за много меньше шагов.
+// Начальное состояние - init_grid (граница постоянна, внутри холодно).
+// Неявные полушаги - пакеты трехдиагональных систем (tridiag.h), которые
+// решаются сразу для многих систем подряд в памяти: для прогонки вдоль строк
+// сетка транспонируется. Шаги идут до max_iters или пока max|u_new - u| > eps,
+// кадры пишутся через snapshot.h так же, как в method_Jacobi_io
+std::pair<int, double> method_ADI(vd A, snapshot_writer* sw) {
+    const int chunk = 64; // систем на задачу прогонки
+    int sub_n = n - 1, N = n - 2;
+    double r = adi_dt, half = r / 2;
+    size_t bytes = (size_t)n * n * sizeof(double);
+    tridiag_plan plan(N, -half, 1 + r, -half);
+    vd U = A;
+    vd R = (vd)malloc(bytes), T1 = (vd)malloc(bytes), T2 = (vd)malloc(bytes);
+    // граница R и T2 (в транспонированном виде) больше не меняется
+    std::memcpy(R, A, bytes);
+    transpose(A, T2, n);
+
+    int iter = 0;
+    double error = eps + 1;
+    bool sw_pending = false;
+    while (error > eps && iter < max_iters) {
+        // полушаг 1: явно по i, правая часть в R
+        #pragma omp parallel for schedule(static)
+        for (int i = 1; i < sub_n; i++) {
+            #pragma omp simd
+            for (int j = 1; j < sub_n; j++)
+                R[ind(i, j)] = (1 - r) * U[ind(i, j)] + half * (U[ind(i - 1, j)] + U[ind(i + 1, j)]);
+            R[ind(i, 1)] += half * U[ind(i, 0)];
+            R[ind(i, sub_n - 1)] += half * U[ind(i, sub_n)];
+        }
+        // неявно по j: в T1 строка j, системы - столбцы i
+        transpose(R, T1, n);
+        #pragma omp parallel for schedule(static)
+        for (int s = 1; s < sub_n; s += chunk)
+            plan.solve(T1 + ind(1, 0), n, s, s + chunk < sub_n ? s + chunk : sub_n);
+
+        // полушаг 2: явно по j (соседние строки T1), правая часть в T2
+        #pragma omp parallel for schedule(static)
+        for (int j = 1; j < sub_n; j++) {
+            #pragma omp simd
+            for (int i = 1; i < sub_n; i++)
+                T2[ind(j, i)] = (1 - r) * T1[ind(j, i)] + half * (T1[ind(j - 1, i)] + T1[ind(j + 1, i)]);
+            T2[ind(j, 1)] += half * T1[ind(j, 0)];
+            T2[ind(j, sub_n - 1)] += half * T1[ind(j, sub_n)];
+        }
+        // неявно по i: обратно в обычный порядок, системы - столбцы j
+        transpose(T2, R, n);
+        #pragma omp parallel for schedule(static)
+        for (int s = 1; s < sub_n; s += chunk)
+            plan.solve(R + ind(1, 0), n, s, s + chunk < sub_n ? s + chunk : sub_n);
+
+        error = 0;
+        #pragma omp parallel for reduction(max:error) schedule(static)
+        for (int i = 1; i < sub_n; i++) {
+            for (int j = 1; j < sub_n; j++)
+                error = max(error, abs(R[ind(i, j)] - U[ind(i, j)]));
+        }
+        // отданный в кадр U станет R и будет перезаписан на следующем шаге
+        if (sw_pending)
+            snapshot_wait_copy(*sw);
+        sw_pending = false;
+        std::swap(U, R);
+
+        iter++;
+        if (sw != nullptr && iter % snapshot_every == 0)
+            sw_pending = snapshot_offer(*sw, U, iter, error);
+    }
+    if (sw_pending)
+        snapshot_wait_copy(*sw);
+
+    if (U != A) {
+        std::memcpy(A, U, bytes);
+        std::swap(U, R);
+    }
+    free(R);
+    free(T1);
+    free(T2);
+    return std::make_pair(iter, error);
+}
+
+// bfloat16: старшие 16 бит float, хранится только для экономии полосы
+struct bf16 {
+    uint16_t bits;
+};
+
+inline double load(float v) { return v; }
+inline double load(bf16 v) {
+    uint32_t u = (uint32_t)v.bits << 16;
+    float f;
+    std::memcpy(&f, &u, sizeof(f));
+    return f;
+}
+inline void store(float& dst, double v) { dst = (float)v; }
+// округление к ближайшему четному
+inline void store(bf16& dst, double v) {
+    float f = (float)v;
+    uint32_t u;
+    std::memcpy(&u, &f, sizeof(u));
+    u += 0x7fff + ((u >> 16) & 1);
+    dst.bits = (uint16_t)(u >> 16);
+}
+
+// относительный шаг хранимых значений: 2^-23 у float, 2^-7 у bf16
+template<typename T> double storage_ulp();
+template<> double storage_ulp<float>() { return 1.0 / (1 << 23); }
+template<> double storage_ulp<bf16>() { return 1.0 / (1 << 7); }
+
+// изменение за проход ниже LOWP_STALL_ULPS шагов хранения - уже шум округления;
+// без снижения change хотя бы в LOWP_STALL_DROP раз за LOWP_STALL_WINDOW
+// проходов фаза тоже считается застрявшей
+#define LOWP_STALL_ULPS 4
+#define LOWP_STALL_DROP 0.99
+#define LOWP_STALL_WINDOW 64
+// доля max_iters, которая всегда остается на доводку в double
+#define LOWP_POLISH_SHARE 4
+
+// строка шаблона на сетке типа T: чтение с расширением до double, сумма
+// и ошибка в double, запись с округлением - все в одном векторном цикле
+template<typename T>
+STENCIL_CLONES
+double lowp_row(const T* up, const T* mid, const T* down, T* out, int m) {
+    double error = 0;
+    #pragma omp simd reduction(max:error)
+    for (int j = 1; j < m - 1; j++) {
+        double v = (load(up[j]) + load(down[j]) + load(mid[j - 1]) + load(mid[j + 1])) * 0.25;
+        T s;
+        store(s, v);
+        out[j] = s;
+        double d = load(s) - load(mid[j]);
+        d = d < 0 ? -d : d;
+        error = d > error ? d : error;
+    }
+    return error;
+}
+
+// Якоби на сетках типа T, error - по хранимым значениям. Фаза кончается,
+// когда изменение за проход упирается в шаг хранения (floor) или перестает
+// падать; дальше пониженная точность не приближает к решению
+template<typename T>
+std::pair<int, double> jacobi_lowp(T* A, T* Anew, int iters, double floor) {
+    int iter = 0;
+    double error = eps + 1;
+    double best = error;
+    int best_iter = 0;
+    int sub_n = n - 1;
+
+    while (error > eps && error > floor && iter < iters && iter - best_iter < LOWP_STALL_WINDOW) {
+        error = 0;
+
+        #pragma omp parallel for reduction(max:error) schedule(static)
+        for (int i = 1; i < sub_n; i++) {
+            double row_error = lowp_row(A + ind(i - 1, 0), A + ind(i, 0), A + ind(i + 1, 0), Anew + ind(i, 0), n);
+            error = max(error, row_error);
+        }
+        std::swap(A, Anew);
+
+        iter++;
+        if (error < best * LOWP_STALL_DROP) {
+            best = error;
+            best_iter = iter;
+        }
+    }
+
+    return std::make_pair(iter, error);
+}
+
+// Якоби с пониженной точностью хранения: первая часть итераций идет
+// на сетках float/bf16 (4/2 байта на ячейку вместо 8), пока изменение за
+// проход заметно больше шага хранения, затем решение переводится в double
+// и доводится обычным проходом до eps. На доводку всегда остается не меньше
+// max_iters / LOWP_POLISH_SHARE итераций.
+// Граница в double не теряет точность: переносится только внутренность
+template<typename T>
+std::pair<int, double> method_Jacobi_mixed(vd A) {
+    size_t cells = (size_t)n * n;
+    std::vector<T> lo(cells), lo_new(cells);
+    double scale = 0;
+    for (size_t k = 0; k < cells; k++) {
+        store(lo[k], A[k]);
+        scale = max(scale, abs(A[k]));
+    }
+    lo_new = lo;
+
+    int polish_budget = max(max_iters / LOWP_POLISH_SHARE, 1);
+    int low_budget = max(max_iters - polish_budget, 0);
+    std::pair<int, double> low = jacobi_lowp(lo.data(), lo_new.data(), low_budget,
+                                             LOWP_STALL_ULPS * storage_ulp<T>() * scale);
+    const T* result = low.first % 2 == 0 ? lo.data() : lo_new.data();
+    int sub_n = n - 1;
+    #pragma omp parallel for schedule(static)
+    for (int i = 1; i < sub_n; i++)
+        for (int j = 1; j < sub_n; j++)
+            A[ind(i, j)] = load(result[ind(i, j)]);
+    lowp_iters = low.first;
+
+    // доводка в double
+    int saved_iters = max_iters;
+    max_iters -= low.first;
+    vd B = (vd)malloc(cells * sizeof(double));
+    std::memcpy(B, A, cells * sizeof(double));
+    std::pair<int, double> polish = stencil_row != nullptr ? method_Jacobi_simd(A, B) : method_Jacobi(A, B);
+    max_iters = saved_iters;
+    if (polish.first % 2 == 1)
+        std::memcpy(A, B, cells * sizeof(double));
+    free(B);
+
+    // без доводки (max_iters = 0) последняя измеренная ошибка - у первой фазы
+    return std::make_pair(low.first + polish.first, polish.first > 0 ? polish.second : low.second);
+}
+
+// Якоби с выводом по ходу счета: контрольные точки (ck) и/или кадры (sw),
+// любой из указателей может быть nullptr. Текущая сетка отдается фоновому
+// потоку сразу после обмена: следующий проход ее только читает, а перезапишет
+// лишь через итерацию, поэтому ждать нужно только окончания копирования,
+// и то после целого прохода. Диск решатель не ждет никогда.
+// При restart состояние, итерация и ошибка берутся из контрольной точки
+std::pair<int, double> method_Jacobi_io(vd A, vd Anew, checkpoint_file* ck, snapshot_writer* sw) {
+    int iter = 0;
+    double error = eps + 1;
+    int sub_n = n - 1;
+    stencil_row_fn row_kernel = stencil_row != nullptr ? stencil_row : stencil_row_scalar;
+    vd orig_A = A;
+
+    if (restart) {
+        int s = checkpoint_latest(*ck);
+        std::memcpy(A, ck->slot(s), n * n * sizeof(double));
+        iter = ck->header()->iters[s];
+        error = ck->header()->errors[s];
+        std::cout << "Restart from iteration " << iter << "\n";
+    }
+
+    // фоновые потоки копируют A, которую перезапишет следующий проход
+    bool ck_pending = false, sw_pending = false;
+    while (error > eps && iter < max_iters) {
+        error = 0;
+
+        #pragma omp parallel for reduction(max:error) schedule(static)
+        for (int i = 1; i < sub_n; i++) {
+            double row_error = row_kernel(A + ind(i - 1, 0), A + ind(i, 0), A + ind(i + 1, 0),
+                                          Anew + ind(i, 0), n);
+            error = max(error, row_error);
+        }
+        if (ck_pending)
+            checkpoint_wait_copy(*ck);
+        if (sw_pending)
+            snapshot_wait_copy(*sw);
+        ck_pending = sw_pending = false;
+        std::swap(A, Anew);
+
+        iter++;
+        if (ck != nullptr && iter % checkpoint_every == 0 && !checkpoint_busy(*ck)) {
+            checkpoint_save_async(*ck, A, iter, error);
+            ck_pending = true;
+        }
+        if (sw != nullptr && iter % snapshot_every == 0)
+            sw_pending = snapshot_offer(*sw, A, iter, error);
+    }
+    if (ck_pending)
+        checkpoint_wait_copy(*ck);
+    if (sw_pending)
+        snapshot_wait_copy(*sw);
+
+    if (A != orig_A)
+        std::memcpy(orig_A, A, n * n * sizeof(double));
+    return std::make_pair(iter, error);
+}
+
+// строки "tl tr bl br", пустые и начинающиеся с # пропускаются
+bool read_batch(const std::string& path, std::vector<boundary_spec>& specs) {
+    std::ifstream in(path);
+    if (!in)
+        return false;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::istringstream fields(line);
+        boundary_spec b;
+        if (!(fields >> b.tl >> b.tr >> b.bl >> b.br))
+            return false;
+        specs.push_back(b);
+    }
+    return true;
+}
+
+#define BATCH_LANES 8 // задач в пачке, по одной на SIMD-линию
+
+// ячейка (i, j) линии p пачки
+inline size_t batch_ind(int i, int j, int p) {
+    return ((size_t)i * n + j) * BATCH_LANES + p;
+}
+
+// записать задачу spec в линию p пачки (обе сетки), граница - как в init_grid,
+// чтобы линия считалась бит в бит как отдельный запуск
+void batch_load_lane(vd A, vd Anew, int p, const boundary_spec& spec) {
+    for (int i = 0; i < n; i++)
+        for (int j = 0; j < n; j++)
+            A[batch_ind(i, j, p)] = 0;
+    vd inter = interpolation(spec.tl, spec.tr);
+    for (int i = 0; i < n; i++)
+        A[batch_ind(0, i, p)] = inter[i];
+    free(inter);
+    inter = interpolation(spec.tl, spec.bl);
+    for (int i = 0; i < n; i++)
+        A[batch_ind(i, 0, p)] = inter[i];
+    free(inter);
+    inter = interpolation(spec.tr, spec.br);
+    for (int i = 0; i < n; i++)
+        A[batch_ind(i, n - 1, p)] = inter[i];
+    free(inter);
+    inter = interpolation(spec.bl, spec.br);
+    for (int i = 0; i < n; i++)
+        A[batch_ind(n - 1, i, p)] = inter[i];
+    free(inter);
+    for (int i = 0; i < n; i++)
+        for (int j = 0; j < n; j++)
+            Anew[batch_ind(i, j, p)] = A[batch_ind(i, j, p)];
+}
+
+// один проход по пачке, err - ошибка каждой линии
+STENCIL_CLONES
+void batch_sweep(const double* A, double* Anew, double* err) {
+    int sub_n = n - 1;
+    double e[BATCH_LANES] = {0};
+    for (int i = 1; i < sub_n; i++) {
+        for (int j = 1; j < sub_n; j++) {
+            #pragma omp simd
+            for (int p = 0; p < BATCH_LANES; p++) {
+                double v = (A[batch_ind(i - 1, j, p)] + A[batch_ind(i + 1, j, p)] +
+                            A[batch_ind(i, j - 1, p)] + A[batch_ind(i, j + 1, p)]) * 0.25;
+                double d = v - A[batch_ind(i, j, p)];
+                d = d < 0 ? -d : d;
+                e[p] = d > e[p] ? d : e[p];
+                Anew[batch_ind(i, j, p)] = v;
+            }
+        }
+    }
+    for (int p = 0; p < BATCH_LANES; p++)
+        err[p] = e[p];
+}
+
+// Пакетный Якоби для множества мелких задач. Сетки BATCH_LANES задач
+// перемежаются поячеечно, так что внутренний цикл по задачам - это одна
+// векторная операция, а у каждой линии своя ошибка и свой счетчик итераций.
+// Сошедшаяся задача сразу уходит из пачки, а ее линию занимает следующая из
+// очереди, поэтому линии заняты до конца очереди. Каждый поток ведет свою пачку
+std::vector<std::pair<int, double>> method_Jacobi_batch(const std::vector<boundary_spec>& specs) {
+    std::vector<std::pair<int, double>> results(specs.size());
+    std::atomic<int> next(0);
+    size_t pack = (size_t)n * n * BATCH_LANES;
+
+    #pragma omp parallel
+    {
+        std::vector<double> bufA(pack, 0.0), bufB(pack, 0.0);
+        vd A = bufA.data(), Anew = bufB.data();
+        int task[BATCH_LANES], iters[BATCH_LANES];
+        int active = 0;
+        for (int p = 0; p < BATCH_LANES; p++) {
+            task[p] = next++;
+            iters[p] = 0;
+            if (task[p] < (int)specs.size()) {
+                batch_load_lane(A, Anew, p, specs[task[p]]);
+                active++;
+            } else {
+                task[p] = -1;
+            }
+        }
+
+        while (active > 0) {
+            double err[BATCH_LANES];
+            batch_sweep(A, Anew, err);
+            std::swap(A, Anew);
+
+            for (int p = 0; p < BATCH_LANES; p++) {
+                if (task[p] < 0)
+                    continue;
+                iters[p]++;
+                if (err[p] > eps && iters[p] < max_iters)
+                    continue;
+                results[task[p]] = std::make_pair(iters[p], err[p]);
+                task[p] = next++;
+                iters[p] = 0;
+                if (task[p] < (int)specs.size()) {
+                    batch_load_lane(A, Anew, p, specs[task[p]]);
+                } else {
+                    task[p] = -1;
+                    active--;
+                }
+            }
+        }
+    }
+    return results;
+}
+
 int parse_args(int argc, char** argv) {
     boost::program_options::options_description desc("Heat Equation Solver Options");
     desc.add_options()
@@ -92,6 +1679,32 @@ int parse_args(int argc, char** argv) {
         ("n", boost::program_options::value<int>()->default_value(256), "grid size")
         ("eps", boost::program_options::value<double>()->default_value(1.0e-6), "precision")
         ("iter", boost::program_options::value<int>()->default_value(1000000), "max iterations")
+        ("method", boost::program_options::value<std::string>()->default_value("jacobi"), "solver: jacobi, sor (red-black, optimal omega), mg (multigrid V-cycles), cg (conjugate gradients), dst (direct, sine transform) or adi (implicit time steps of --dt)")
+        ("dt", boost::program_options::value<double>()->default_value(10), "adi time step in units of h^2 (explicit jacobi is stable up to 0.25)")
+        ("precond", boost::program_options::value<std::string>()->default_value("ssor"), "cg preconditioner: none, jacobi or ssor")
+        ("simd", boost::program_options::value<std::string>()->default_value("auto"), "stencil kernel: auto, avx512, avx2, scalar or off (OpenACC loop)")
+        ("storage", boost::program_options::value<std::string>()->default_value("double"), "jacobi grid storage: double, float or bf16 (double accumulate and final polish)")
+        ("checkpoint", boost::program_options::value<std::string>()->default_value(""), "jacobi checkpoint file (memory-mapped)")
+        ("checkpoint-every", boost::program_options::value<int>()->default_value(10000), "iterations between checkpoints")
+        ("restart", "resume jacobi from the checkpoint file")
+        ("snapshot", boost::program_options::value<std::string>()->default_value(""), "file for binary frames of intermediate jacobi grids")
+        ("snapshot-every", boost::program_options::value<int>()->default_value(1000), "iterations between frames")
+        ("pipelined", "jacobi in one parallel region with the error check lagged by one sweep")
+        ("private", "jacobi on thread-private padded row bands with halo row exchange")
+        ("inplace", "jacobi on a single grid with rolling row buffers (half the memory)")
+        ("corners", boost::program_options::value<std::vector<double>>()->multitoken()
+                        ->default_value(std::vector<double>{10, 20, 20, 30}, "10 20 20 30"), "corner temperatures: tl tr bl br")
+        ("cache", boost::program_options::value<std::string>()->default_value(""), "directory with cached converged solutions")
+        ("warm-start", "start from the closest solution in --cache")
+        ("batch", boost::program_options::value<std::string>()->default_value(""), "solve many problems at once: file with corner temperatures \"tl tr bl br\" per line")
+        ("check", boost::program_options::value<std::string>()->default_value("1"), "sweeps between error checks or adaptive")
+        ("telemetry", boost::program_options::value<std::string>()->default_value(""), "per-iteration telemetry of the plain jacobi, written as .json or .csv")
+        ("numa-bind", "pin row bands of the grids to the NUMA node of the thread that sweeps them")
+        ("generic", "do not use the jacobi kernels specialized for n = 128 ... 4096")
+        ("tblock", boost::program_options::value<int>()->default_value(1), "iterations per tile for temporal blocking (1 - plain sweep)")
+        ("tile", boost::program_options::value<int>()->default_value(128), "tile edge for temporal blocking and the task graph")
+        ("graph", boost::program_options::value<int>()->default_value(0), "sweeps per replay of the tile task graph (0 - off)")
+        ("mask", boost::program_options::value<std::string>()->default_value(""), "jacobi domain mask: n lines of n cells, '.' active, '#' fixed temperature, 'o' insulated")
         ("profile", "enable profiling");
     
     boost::program_options::variables_map vm;
@@ -107,6 +1720,99 @@ int parse_args(int argc, char** argv) {
         n = vm["n"].as<int>();
         eps = vm["eps"].as<double>();
         max_iters = vm["iter"].as<int>();
+        method = vm["method"].as<std::string>();
+        if (method != "jacobi" && method != "sor" && method != "mg" && method != "cg" &&
+            method != "dst" && method != "adi") {
+            std::cout << "Error: unknown method " << method << "\n";
+            return 2;
+        }
+        adi_dt = vm["dt"].as<double>();
+        if (!(adi_dt > 0)) {
+            std::cout << "Error: dt must be positive\n";
+            return 2;
+        }
+        precond = vm["precond"].as<std::string>();
+        if (precond != "none" && precond != "jacobi" && precond != "ssor") {
+            std::cout << "Error: unknown preconditioner " << precond << "\n";
+            return 2;
+        }
+        inplace = vm.count("inplace") > 0;
+        pipelined = vm.count("pipelined") > 0;
+        subdomains = vm.count("private") > 0;
+        checkpoint_path = vm["checkpoint"].as<std::string>();
+        checkpoint_every = vm["checkpoint-every"].as<int>();
+        restart = vm.count("restart") > 0;
+        if (checkpoint_every < 1) {
+            std::cout << "Error: checkpoint-every must be positive\n";
+            return 2;
+        }
+        snapshot_path = vm["snapshot"].as<std::string>();
+        snapshot_every = vm["snapshot-every"].as<int>();
+        if (snapshot_every < 1) {
+            std::cout << "Error: snapshot-every must be positive\n";
+            return 2;
+        }
+        if (restart && checkpoint_path.empty()) {
+            std::cout << "Error: restart needs --checkpoint\n";
+            return 2;
+        }
+        storage = vm["storage"].as<std::string>();
+        if (storage != "double" && storage != "float" && storage != "bf16") {
+            std::cout << "Error: unknown storage " << storage << "\n";
+            return 2;
+        }
+        batch_path = vm["batch"].as<std::string>();
+        std::vector<double> c = vm["corners"].as<std::vector<double>>();
+        if (c.size() != 4) {
+            std::cout << "Error: corners needs 4 values\n";
+            return 2;
+        }
+        corners = {c[0], c[1], c[2], c[3]};
+        cache_dir = vm["cache"].as<std::string>();
+        warm_start = vm.count("warm-start") > 0;
+        if (warm_start && cache_dir.empty()) {
+            std::cout << "Error: warm-start needs --cache\n";
+            return 2;
+        }
+        telemetry_path = vm["telemetry"].as<std::string>();
+#ifdef NO_TELEMETRY
+        if (!telemetry_path.empty()) {
+            std::cout << "Error: built without telemetry\n";
+            return 2;
+        }
+#endif
+        std::string check = vm["check"].as<std::string>();
+        if (check == "adaptive") {
+            check_every = 0;
+        } else {
+            check_every = std::atoi(check.c_str());
+            if (check_every < 1) {
+                std::cout << "Error: check must be a positive number or adaptive\n";
+                return 2;
+            }
+        }
+        generic = vm.count("generic") > 0;
+        numa_bind_pages = vm.count("numa-bind") > 0;
+        tblock_steps = vm["tblock"].as<int>();
+        tile_size = vm["tile"].as<int>();
+        graph_steps = vm["graph"].as<int>();
+        if (tile_size < 1 || graph_steps < 0) {
+            std::cout << "Error: tile must be positive and graph not negative\n";
+            return 2;
+        }
+        mask_path = vm["mask"].as<std::string>();
+        if (!mask_path.empty() && (!batch_path.empty() || !cache_dir.empty())) {
+            std::cout << "Error: --mask cannot be combined with --batch or --cache\n";
+            return 2;
+        }
+        simd_isa = vm["simd"].as<std::string>();
+        if (simd_isa != "off") {
+            stencil_row = select_stencil_row(simd_isa.c_str(), &stencil_name);
+            if (stencil_row == nullptr) {
+                std::cout << "Error: kernel " << simd_isa << " is not supported on this CPU\n";
+                return 2;
+            }
+        }
         
         if (vm.count("profile")) {
             max_iters = 50;  // for profiling
@@ -131,15 +1837,215 @@ int main(int argc, char** argv) {
             break;
     }
 
-    vd A = init_grid();
-    vd A_new = init_grid();
+    if (tblock_steps > 1 && (method != "jacobi" || inplace || storage != "double" || !batch_path.empty())) {
+        std::cout << "Error: --tblock needs the plain two-grid jacobi\n";
+        return 1;
+    }
+    if (!batch_path.empty()) {
+        std::vector<boundary_spec> specs;
+        if (!read_batch(batch_path, specs)) {
+            std::cout << "Error: cannot read batch file " << batch_path << "\n";
+            return 1;
+        }
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::pair<int, double>> results = method_Jacobi_batch(specs);
+        auto end = std::chrono::steady_clock::now();
+        std::chrono::duration<double> dur = end - start;
+        for (size_t k = 0; k < results.size(); k++)
+            std::cout << "Problem " << k << ": Iters: " << results[k].first
+                      << " Error: " << results[k].second << "\n";
+        std::cout << "Problems: " << results.size() << "\n";
+        std::cout << "Elapsed time: " << dur.count() << "\n";
+        return 0;
+    }
+
+    // второй буфер нужен только двухсеточному Якоби
+    bool two_grids = method == "jacobi" && !inplace && storage == "double";
+    checkpoint_file ck;
+    snapshot_writer sw;
+    bool with_io = !checkpoint_path.empty() || !snapshot_path.empty();
+    if (check_every != 1 && (!two_grids || tblock_steps > 1 || with_io || pipelined)) {
+        std::cout << "Error: --check needs the plain two-grid jacobi\n";
+        return 1;
+    }
+    if (pipelined && (!two_grids || tblock_steps > 1 || with_io)) {
+        std::cout << "Error: --pipelined needs the plain two-grid jacobi without --tblock, checkpoints or snapshots\n";
+        return 1;
+    }
+    if (!telemetry_path.empty() && (!two_grids || tblock_steps > 1 || with_io || pipelined || check_every != 1)) {
+        std::cout << "Error: --telemetry is recorded by the plain two-grid jacobi only\n";
+        return 1;
+    }
+    if (subdomains && (!two_grids || tblock_steps > 1 || with_io || pipelined || check_every != 1 ||
+                       graph_steps > 0 || !telemetry_path.empty())) {
+        std::cout << "Error: --private needs the plain two-grid jacobi\n";
+        return 1;
+    }
+    if (graph_steps > 0 && (!two_grids || tblock_steps > 1 || with_io || pipelined || check_every != 1 ||
+                            !telemetry_path.empty())) {
+        std::cout << "Error: --graph needs the plain two-grid jacobi\n";
+        return 1;
+    }
+    if (!mask_path.empty() && (!two_grids || tblock_steps > 1 || with_io || pipelined || check_every != 1 ||
+                               subdomains || graph_steps > 0 || !telemetry_path.empty())) {
+        std::cout << "Error: --mask needs the plain two-grid jacobi\n";
+        return 1;
+    }
+    domain_mask mask;
+    if (!mask_path.empty()) {
+        std::string mask_err = mask_load(mask_path, n, mask);
+        if (!mask_err.empty()) {
+            std::cout << "Error: " << mask_err << "\n";
+            return 1;
+        }
+    }
+    if (with_io && (!two_grids || tblock_steps > 1) && (method != "adi" || !checkpoint_path.empty())) {
+        std::cout << "Error: checkpoints are supported for the plain two-grid jacobi only, snapshots also for adi\n";
+        return 1;
+    }
+    std::string io_err;
+    if (!checkpoint_path.empty())
+        io_err = checkpoint_open(ck, checkpoint_path, n, restart);
+    if (io_err.empty() && !snapshot_path.empty())
+        io_err = snapshot_open(sw, snapshot_path, n);
+    if (!io_err.empty()) {
+        std::cout << "Error: " << io_err << "\n";
+        checkpoint_close(ck);
+        snapshot_close(sw);
+        return 1;
+    }
+    // обычный двухсеточный Якоби считает библиотека, сетки лежат в ней
+    bool use_lib = two_grids && stencil_row != nullptr && !with_io && !pipelined && check_every == 1 &&
+                   tblock_steps <= 1 && graph_steps == 0 && !subdomains && mask_path.empty();
+    heat_solver lib;
+    if (use_lib) {
+        heat_config cfg = heat_default_config();
+        cfg.n = n;
+        cfg.max_iters = max_iters;
+        cfg.eps = eps;
+        cfg.tl = corners.tl;
+        cfg.tr = corners.tr;
+        cfg.bl = corners.bl;
+        cfg.br = corners.br;
+        cfg.simd = simd_isa.c_str();
+        cfg.generic = generic;
+        cfg.numa_bind = numa_bind_pages;
+        std::string lib_err = lib.open(cfg);
+        if (!lib_err.empty()) {
+            std::cout << "Error: " << lib_err << "\n";
+            return 1;
+        }
+        stencil_name = lib.kernel();
+    }
+    vd A = use_lib ? lib.grid() : init_grid();
+    vd A_new = two_grids && !use_lib ? init_grid() : nullptr;
+    if (A == nullptr || (two_grids && !use_lib && A_new == nullptr)) {
+        std::cout << "Error: out of memory\n";
+        checkpoint_close(ck);
+        snapshot_close(sw);
+        if (!use_lib)
+            free(A);
+        free(A_new);
+        return 1;
+    }
+    if (warm_start) {
+        // граница остается своей, из кэша берется только внутренность
+        std::string path;
+        double dist;
+        std::vector<double> cached;
+        int m;
+        if (cache_closest(cache_dir, cache_profile(A, n), n, path, dist) && cache_load(path, cached, m)) {
+            cache_resample(cached.data(), m, A, n);
+            std::cout << "Warm start: " << path << " (" << m << "x" << m << ", boundary distance " << dist << ")\n";
+        } else {
+            std::cout << "Warm start: cache is empty\n";
+        }
+    }
+    size_t grid_bytes = use_lib ? lib.grid_bytes() : (size_t)n * n * sizeof(double);
+    std::cout << "NUMA: " << numa_report(A, grid_bytes) << (numa_bind_pages ? ", bound" : "") << "\n";
+    if (!mask_path.empty())
+        std::cout << "Mask: " << mask.active << " active cells, " << mask.runs.size() << " runs, "
+                  << mask.cell.size() << " packed\n";
+    telemetry telemetry_data;
+    if (!telemetry_path.empty()) {
+        telemetry_init(telemetry_data, n);
+        telem = &telemetry_data;
+        lib.set_telemetry(telem);
+    }
     auto start = std::chrono::steady_clock::now();
-    std::pair<int, double> res = method_Jacobi(A, A_new);
+    std::pair<int, double> res;
+    if (method == "sor")
+        res = method_SOR(A, optimal_omega());
+    else if (method == "mg")
+        res = method_multigrid(A);
+    else if (method == "cg")
+        res = method_CG(A);
+    else if (method == "dst")
+        res = method_DST(A);
+    else if (method == "adi")
+        res = method_ADI(A, snapshot_path.empty() ? nullptr : &sw);
+    else if (storage == "float")
+        res = method_Jacobi_mixed<float>(A);
+    else if (storage == "bf16")
+        res = method_Jacobi_mixed<bf16>(A);
+    else if (inplace)
+        res = method_Jacobi_inplace(A);
+    else if (with_io)
+        res = method_Jacobi_io(A, A_new, checkpoint_path.empty() ? nullptr : &ck,
+                               snapshot_path.empty() ? nullptr : &sw);
+    else if (pipelined)
+        res = method_Jacobi_pipelined(A, A_new);
+    else if (subdomains) {
+        res = method_Jacobi_private(A, A_new);
+        if (res.first < 0) {
+            std::cout << "Error: out of memory for the private subdomains\n";
+            free(A);
+            free(A_new);
+            return 1;
+        }
+    }
+    else if (check_every != 1)
+        res = method_Jacobi_checked(A, A_new);
+    else if (tblock_steps > 1)
+        res = method_Jacobi_blocked(A, A_new);
+    else if (graph_steps > 0)
+        res = method_Jacobi_graph(A, A_new);
+    else if (!mask_path.empty())
+        res = method_Jacobi_masked(A, A_new, mask);
+    else if (use_lib) {
+        heat_result r = lib.solve();
+        res = std::make_pair(r.iters, r.error);
+    }
+    else
+        res = method_Jacobi(A, A_new);
     auto end = std::chrono::steady_clock::now();
     std::chrono::duration<double> dur = end - start;
+    // двухсеточный Якоби без вывода оставляет решение после нечетного числа итераций в A_new
+    vd result = use_lib ? lib.grid() : two_grids && !with_io && res.first % 2 == 1 ? A_new : A;
+    if (!cache_dir.empty() && res.second <= eps && !cache_store(cache_dir, result, n))
+        std::cout << "Error: cannot write to cache " << cache_dir << "\n";
+    if (method == "sor")
+        std::cout << "Omega: " << optimal_omega() << "\n";
+    else if (method == "jacobi" && storage != "double")
+        std::cout << "Kernel: lowp_row, polish " << stencil_name << "\n";
+    else if (method == "jacobi" && (inplace || pipelined || tblock_steps <= 1))
+        std::cout << "Kernel: " << stencil_name << "\n";
     std::cout << "Iters: " << res.first << "\n";
+    if (method == "jacobi" && storage != "double")
+        std::cout << "Low precision iters: " << lowp_iters << "\n";
     std::cout << "Error: " << res.second << "\n";
     std::cout << "Elapsed time: " << dur.count() << "\n";
-    free(A);
+    if (method == "adi")
+        std::cout << "Time: " << res.first * adi_dt << "\n";
+    if (check_every != 1)
+        std::cout << "Checks: " << checks_done << "\n";
+    if (telem != nullptr && !telemetry_dump(*telem, telemetry_path))
+        std::cout << "Error: cannot write telemetry to " << telemetry_path << "\n";
+    checkpoint_close(ck);
+    snapshot_close(sw);
+    if (!snapshot_path.empty())
+        std::cout << "Snapshots: " << sw.written << " written, " << sw.dropped << " dropped\n";
+    if (!use_lib)
+        free(A);
     free(A_new);
 }
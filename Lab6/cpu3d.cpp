@@ -0,0 +1,159 @@
+#include <iostream>
+#include <vector>
+#include <iomanip>
+#include <chrono>
+#include <cstring>
+#include <omp.h>
+#include <boost/program_options.hpp>
+
+
+using vd = double*;
+int n, max_iters;
+double eps;
+int block_j, block_k; // cache blocking in the j/k planes, i is streamed
+
+#define ind3(i, j, k) (((size_t)(i) * n + (j)) * n + (k))
+#define max(a, b) ((a) > (b) ? (a) : (b))
+#define abs(a) ((a) < 0 ? (0-(a)) : (a))
+
+vd interpolation(double start, double end) {
+    vd res = (vd)malloc(n * sizeof(double));
+    double curr = start;
+    double dx = (end - start) / (n - 1);
+    for (int i = 0; i < n; i++) {
+        res[i] = curr;
+        curr += dx;
+    }
+    return res;
+}
+
+// грани куба: 10 + 10(x + y + z), т.е. вершины от 10 до 40,
+// на каждой грани та же линейная интерполяция, что и в 2D.
+// Внутренность заполняется параллельно теми же блоками, что и проход
+vd init_grid() {
+    size_t total = (size_t)n * n * n;
+    vd res = (vd)malloc(total * sizeof(double));
+    #pragma omp parallel for collapse(2) schedule(static)
+    for (int jb = 0; jb < n; jb += block_j)
+        for (int kb = 0; kb < n; kb += block_k)
+            for (int i = 0; i < n; i++)
+                for (int j = jb; j < n && j < jb + block_j; j++)
+                    std::memset(res + ind3(i, j, kb), 0,
+                                ((kb + block_k < n ? kb + block_k : n) - kb) * sizeof(double));
+
+    vd inter = interpolation(10, 20);
+    for (int a = 0; a < n; a++) {
+        for (int b = 0; b < n; b++) {
+            double v = inter[a] + inter[b] - 20;
+            res[ind3(0, a, b)] = v + inter[0];
+            res[ind3(n - 1, a, b)] = v + inter[n - 1];
+            res[ind3(a, 0, b)] = v + inter[0];
+            res[ind3(a, n - 1, b)] = v + inter[n - 1];
+            res[ind3(a, b, 0)] = v + inter[0];
+            res[ind3(a, b, n - 1)] = v + inter[n - 1];
+        }
+    }
+    free(inter);
+    return res;
+}
+
+// 7-точечный Якоби. Блок j x k держит в кэше три соседние плоскости i,
+// поэтому каждая ячейка A читается из памяти один раз за итерацию
+std::pair<int, double> method_Jacobi(vd A, vd Anew) {
+    int iter = 0;
+    double error = eps + 1; // to enter while loop
+    int sub_n = n - 1;
+    const double sixth = 1.0 / 6.0;
+
+    while (error > eps && iter < max_iters) {
+        error = 0;
+
+        #pragma omp parallel for collapse(2) reduction(max:error) schedule(static)
+        for (int jb = 1; jb < sub_n; jb += block_j) {
+            for (int kb = 1; kb < sub_n; kb += block_k) {
+                int je = jb + block_j < sub_n ? jb + block_j : sub_n;
+                int ke = kb + block_k < sub_n ? kb + block_k : sub_n;
+                for (int i = 1; i < sub_n; i++) {
+                    for (int j = jb; j < je; j++) {
+                        for (int k = kb; k < ke; k++) {
+                            Anew[ind3(i, j, k)] = (A[ind3(i - 1, j, k)] + A[ind3(i + 1, j, k)] +
+                                                   A[ind3(i, j - 1, k)] + A[ind3(i, j + 1, k)] +
+                                                   A[ind3(i, j, k - 1)] + A[ind3(i, j, k + 1)]) * sixth;
+                            error = max(error, abs(Anew[ind3(i, j, k)] - A[ind3(i, j, k)]));
+                        }
+                    }
+                }
+            }
+        }
+        std::swap(A, Anew);
+
+        iter++;
+    }
+
+    return std::make_pair(iter, error);
+}
+
+int parse_args(int argc, char** argv) {
+    boost::program_options::options_description desc("3D Heat Equation Solver Options");
+    desc.add_options()
+        ("help", "help message")
+        ("n", boost::program_options::value<int>()->default_value(128), "grid size (n x n x n)")
+        ("eps", boost::program_options::value<double>()->default_value(1.0e-6), "precision")
+        ("iter", boost::program_options::value<int>()->default_value(1000000), "max iterations")
+        ("bj", boost::program_options::value<int>()->default_value(16), "block size along j")
+        ("bk", boost::program_options::value<int>()->default_value(256), "block size along k (contiguous)")
+        ("profile", "enable profiling");
+
+    boost::program_options::variables_map vm;
+    try {
+        boost::program_options::store(boost::program_options::parse_command_line(argc, argv, desc), vm);
+        boost::program_options::notify(vm);
+
+        if (vm.count("help")) {
+            std::cout << desc << "\n";
+            return 1;
+        }
+
+        n = vm["n"].as<int>();
+        eps = vm["eps"].as<double>();
+        max_iters = vm["iter"].as<int>();
+        block_j = vm["bj"].as<int>();
+        block_k = vm["bk"].as<int>();
+        if (block_j < 1 || block_k < 1) {
+            std::cout << "Error: block sizes must be positive\n";
+            return 2;
+        }
+
+        if (vm.count("profile")) {
+            max_iters = 50;  // for profiling
+            std::cout << "PROFILING MODE\n";
+        }
+    } catch (const std::exception& e) {
+        std::cout << "Error: " << e.what() << "\n";
+        return 2;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    switch (parse_args(argc, argv)) {
+        case 1:
+            return 0;
+        case 2:
+            return 1;
+        default:
+            break;
+    }
+
+    vd A = init_grid();
+    vd A_new = init_grid();
+    auto start = std::chrono::steady_clock::now();
+    std::pair<int, double> res = method_Jacobi(A, A_new);
+    auto end = std::chrono::steady_clock::now();
+    std::chrono::duration<double> dur = end - start;
+    std::cout << "Iters: " << res.first << "\n";
+    std::cout << "Error: " << res.second << "\n";
+    std::cout << "Elapsed time: " << dur.count() << "\n";
+    free(A);
+    free(A_new);
+}
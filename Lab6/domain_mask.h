@@ -0,0 +1,123 @@
+#pragma once
+// Область произвольной формы: маска m x m из текстового файла, m строк по m
+// символов:
+//   '.' - считаемая ячейка;
+//   '#' - дыра с постоянной температурой, держит начальное значение
+//         (на рамке - граничное из углов, внутри - 0);
+//   'o' - теплоизолированное включение: поток через его стороны нулевой,
+//         соседняя ячейка вместо его значения берет свое.
+// Рамка сетки никогда не считается, '.' на ней - ошибка.
+// Проход не проверяет маску по ячейкам, считаемые ячейки сжаты в два списка:
+//  - отрезки строк не короче MASK_MIN_RUN без изолированных соседей - их
+//    считает ядро строки stencil_row, как в обычном Якоби;
+//  - короткие отрезки и ячейки рядом с включениями упакованы подряд вместе
+//    с индексами четырех соседей, векторный цикл по ним идет с полными
+//    регистрами (gather), а не по огрызкам строк.
+// Дыры и включения не читаются и не пишутся, кроме соседних с областью.
+#include <fstream>
+#include <string>
+#include <vector>
+#include "stencil_simd.h"
+
+#define MASK_ACTIVE '.'
+#define MASK_FIXED '#'
+#define MASK_INSULATED 'o'
+#define MASK_MIN_RUN 8
+#define MASK_MAX_SIDE 46340 // индексы ячеек упакованного списка - int
+
+// активные ячейки [j0, j1) строки row
+struct mask_run {
+    int row, j0, j1;
+};
+
+struct domain_mask {
+    int m = 0;
+    size_t active = 0;
+    std::vector<mask_run> runs;
+    // упакованные ячейки: индекс и индексы соседей сверху, снизу, слева, справа
+    std::vector<int> cell, up, down, left, right;
+};
+
+// прочитать маску и сжать ее, пустая строка - успех
+inline std::string mask_load(const std::string& path, int m, domain_mask& dm) {
+    if (m > MASK_MAX_SIDE)
+        return "grid is too large for a mask";
+    std::ifstream in(path);
+    if (!in)
+        return "cannot read mask " + path;
+    std::vector<std::string> rows;
+    std::string line;
+    while ((int)rows.size() < m && std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if ((int)line.size() != m)
+            return "mask line " + std::to_string(rows.size() + 1) + " must have " + std::to_string(m) + " cells";
+        for (char c : line)
+            if (c != MASK_ACTIVE && c != MASK_FIXED && c != MASK_INSULATED)
+                return std::string("unknown mask cell '") + c + "'";
+        rows.push_back(line);
+    }
+    if ((int)rows.size() != m)
+        return "mask must have " + std::to_string(m) + " lines";
+    for (int k = 0; k < m; k++)
+        if (rows[0][k] == MASK_ACTIVE || rows[m - 1][k] == MASK_ACTIVE ||
+            rows[k][0] == MASK_ACTIVE || rows[k][m - 1] == MASK_ACTIVE)
+            return "mask border cells cannot be active";
+
+    dm = domain_mask();
+    dm.m = m;
+    auto is = [&](int i, int j, char c) { return rows[i][j] == c; };
+    // сосед (i, j) ячейки c: у изолированного - сама ячейка
+    auto nb = [&](int c, int i, int j) { return is(i, j, MASK_INSULATED) ? c : i * m + j; };
+    auto pack = [&](int i, int j) {
+        int c = i * m + j;
+        dm.cell.push_back(c);
+        dm.up.push_back(nb(c, i - 1, j));
+        dm.down.push_back(nb(c, i + 1, j));
+        dm.left.push_back(nb(c, i, j - 1));
+        dm.right.push_back(nb(c, i, j + 1));
+    };
+    for (int i = 1; i < m - 1; i++) {
+        int j = 1;
+        while (j < m - 1) {
+            if (!is(i, j, MASK_ACTIVE)) {
+                j++;
+                continue;
+            }
+            // отрезок ячеек без изолированных соседей
+            int j1 = j;
+            while (j1 < m - 1 && is(i, j1, MASK_ACTIVE) && !is(i - 1, j1, MASK_INSULATED) &&
+                   !is(i + 1, j1, MASK_INSULATED) && !is(i, j1 - 1, MASK_INSULATED) &&
+                   !is(i, j1 + 1, MASK_INSULATED))
+                j1++;
+            if (j1 - j >= MASK_MIN_RUN) {
+                dm.runs.push_back({i, j, j1});
+            } else {
+                for (int k = j; k < j1; k++)
+                    pack(i, k);
+            }
+            if (j1 == j) // ячейка у включения
+                pack(i, j1++);
+            dm.active += j1 - j;
+            j = j1;
+        }
+    }
+    return "";
+}
+
+// упакованные ячейки [c0, c1): тот же шаблон и та же ошибка, что у stencil_row
+STENCIL_CLONES
+inline double mask_packed_sweep(const domain_mask& dm, const double* A, double* Anew, int c0, int c1) {
+    const int *cell = dm.cell.data(), *up = dm.up.data(), *down = dm.down.data();
+    const int *left = dm.left.data(), *right = dm.right.data();
+    double error = 0;
+    #pragma omp simd reduction(max:error)
+    for (int c = c0; c < c1; c++) {
+        double v = (A[up[c]] + A[down[c]] + A[left[c]] + A[right[c]]) * 0.25;
+        Anew[cell[c]] = v;
+        double d = v - A[cell[c]];
+        d = d < 0 ? -d : d;
+        error = d > error ? d : error;
+    }
+    return error;
+}
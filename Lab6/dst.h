@@ -0,0 +1,159 @@
+#pragma once
+// Дискретное синус-преобразование DST-I без внешних библиотек:
+// DST-I длины N сводится к комплексному БПФ длины M = 2(N + 1) от
+// нечетного продолжения. Для M - степени двойки БПФ radix-2,
+// иначе алгоритм Блюстейна через БПФ степени двойки >= 2M - 1.
+// Планы неизменяемы, рабочие буферы у каждого потока свои.
+#include <cmath>
+#include <complex>
+#include <vector>
+
+typedef std::complex<double> cplx;
+
+// умножение без проверок inf/nan, которые делает operator* (__muldc3)
+inline cplx cmul(cplx a, cplx b) {
+    return cplx(a.real() * b.real() - a.imag() * b.imag(),
+                a.real() * b.imag() + a.imag() * b.real());
+}
+
+// комплексное БПФ radix-2 (вперед, без нормировки)
+class fft_pow2 {
+public:
+    explicit fft_pow2(int L = 1) : L(L), rev(L), tw(L / 2) {
+        int bits = 0;
+        while ((1 << bits) < L)
+            bits++;
+        for (int i = 0; i < L; i++) {
+            int r = 0;
+            for (int b = 0; b < bits; b++)
+                if (i & (1 << b))
+                    r |= 1 << (bits - 1 - b);
+            rev[i] = r;
+        }
+        for (int k = 0; k < L / 2; k++)
+            tw[k] = std::polar(1.0, -2 * M_PI * k / L);
+    }
+
+    int size() const { return L; }
+
+    void forward(cplx* x) const {
+        for (int i = 0; i < L; i++)
+            if (i < rev[i])
+                std::swap(x[i], x[rev[i]]);
+        for (int len = 2; len <= L; len <<= 1) {
+            int half = len / 2, step = L / len;
+            for (int s = 0; s < L; s += len) {
+                for (int k = 0; k < half; k++) {
+                    cplx t = cmul(tw[k * step], x[s + k + half]);
+                    x[s + k + half] = x[s + k] - t;
+                    x[s + k] += t;
+                }
+            }
+        }
+    }
+
+    // обратное через сопряжение, тоже без нормировки
+    void inverse(cplx* x) const {
+        for (int i = 0; i < L; i++)
+            x[i] = std::conj(x[i]);
+        forward(x);
+        for (int i = 0; i < L; i++)
+            x[i] = std::conj(x[i]);
+    }
+
+private:
+    int L;
+    std::vector<int> rev;
+    std::vector<cplx> tw;
+};
+
+// рабочие буферы одного потока
+struct dst_work {
+    std::vector<cplx> ext, conv;
+};
+
+class dst_plan {
+public:
+    explicit dst_plan(int N) : N(N), M(2 * (N + 1)) {
+        if ((M & (M - 1)) == 0) {
+            fft = fft_pow2(M);
+            return;
+        }
+        int L = 1;
+        while (L < 2 * M - 1)
+            L <<= 1;
+        fft = fft_pow2(L);
+        // w_k = exp(-i pi k^2 / M), k^2 берется по модулю 2M ради точности
+        chirp.resize(M);
+        for (long long k = 0; k < M; k++)
+            chirp[k] = std::polar(1.0, -M_PI * (double)((k * k) % (2LL * M)) / M);
+        chirp_fft.assign(L, cplx(0, 0));
+        chirp_fft[0] = std::conj(chirp[0]);
+        for (int k = 1; k < M; k++)
+            chirp_fft[k] = chirp_fft[L - k] = std::conj(chirp[k]);
+        fft.forward(chirp_fft.data());
+    }
+
+    dst_work workspace() const {
+        dst_work w;
+        w.ext.resize(M);
+        w.conv.resize(fft.size());
+        return w;
+    }
+
+    // y_k = sum_j x_j sin(pi (j + 1)(k + 1) / (N + 1)), на месте.
+    // Дважды примененное дает (N + 1) / 2 * x
+    void apply(double* x, dst_work& w) const {
+        cplx* e = w.ext.data();
+        e[0] = e[N + 1] = 0;
+        for (int j = 0; j < N; j++) {
+            e[j + 1] = x[j];
+            e[M - 1 - j] = -x[j];
+        }
+        transform(e, w);
+        for (int k = 0; k < N; k++)
+            x[k] = -0.5 * e[k + 1].imag();
+    }
+
+    // два преобразования одним БПФ: x в действительной части, y в мнимой.
+    // Спектр нечетного действительного продолжения чисто мнимый,
+    // поэтому x и y разделяются без потерь
+    void apply2(double* x, double* y, dst_work& w) const {
+        cplx* e = w.ext.data();
+        e[0] = e[N + 1] = 0;
+        for (int j = 0; j < N; j++) {
+            e[j + 1] = cplx(x[j], y[j]);
+            e[M - 1 - j] = cplx(-x[j], -y[j]);
+        }
+        transform(e, w);
+        for (int k = 0; k < N; k++) {
+            x[k] = -0.5 * e[k + 1].imag();
+            y[k] = 0.5 * e[k + 1].real();
+        }
+    }
+
+private:
+    void transform(cplx* e, dst_work& w) const {
+        if (chirp.empty()) {
+            fft.forward(e);
+            return;
+        }
+        int L = fft.size();
+        cplx* c = w.conv.data();
+        for (int k = 0; k < M; k++)
+            c[k] = cmul(e[k], chirp[k]);
+        for (int k = M; k < L; k++)
+            c[k] = 0;
+        fft.forward(c);
+        for (int k = 0; k < L; k++)
+            c[k] = cmul(c[k], chirp_fft[k]);
+        fft.inverse(c);
+        double inv_L = 1.0 / L;
+        for (int k = 0; k < M; k++)
+            e[k] = cmul(c[k], chirp[k]) * inv_L;
+    }
+
+    int N, M;
+    fft_pow2 fft;
+    std::vector<cplx> chirp, chirp_fft;
+};
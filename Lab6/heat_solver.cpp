@@ -0,0 +1,165 @@
+#include "heat_solver.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <utility>
+#include <omp.h>
+#include "numa_place.h"
+
+heat_config heat_default_config(void) {
+    heat_config cfg;
+    cfg.n = 256;
+    cfg.max_iters = 1000000;
+    cfg.eps = 1.0e-6;
+    cfg.tl = 10;
+    cfg.tr = 20;
+    cfg.bl = 20;
+    cfg.br = 30;
+    cfg.threads = 0;
+    cfg.simd = nullptr;
+    cfg.generic = 0;
+    cfg.numa_bind = 0;
+    return cfg;
+}
+
+// та же интерполяция накоплением шага, что и в init_grid у cpu,
+// чтобы граница совпадала побитово
+static void fill_side(double* grid, size_t first, size_t step, int m, double start, double end) {
+    double curr = start;
+    double dx = (end - start) / (m - 1);
+    for (int k = 0; k < m; k++) {
+        grid[first + k * step] = curr;
+        curr += dx;
+    }
+}
+
+static size_t grid_size(const heat_config& cfg) {
+    return ((size_t)cfg.n * cfg.n * sizeof(double) + STENCIL_ALIGN - 1) / STENCIL_ALIGN * STENCIL_ALIGN;
+}
+
+// страницы обнуляются теми же потоками и полосами, что и в solve
+static double* alloc_grid(const heat_config& cfg) {
+    size_t bytes = grid_size(cfg);
+    void* mem = nullptr;
+    if (posix_memalign(&mem, STENCIL_ALIGN, bytes) != 0)
+        return nullptr;
+    double* grid = (double*)mem;
+    numa_first_touch(grid, cfg.n, bytes, cfg.threads, cfg.numa_bind != 0);
+    int m = cfg.n;
+    fill_side(grid, 0, 1, m, cfg.tl, cfg.tr);
+    fill_side(grid, 0, m, m, cfg.tl, cfg.bl);
+    fill_side(grid, m - 1, m, m, cfg.tr, cfg.br);
+    fill_side(grid, (size_t)(m - 1) * m, 1, m, cfg.bl, cfg.br);
+    return grid;
+}
+
+heat_solver::~heat_solver() {
+    release();
+}
+
+void heat_solver::release() {
+    free(cur);
+    free(next);
+    cur = next = nullptr;
+}
+
+std::string heat_solver::open(const heat_config& c) {
+    release();
+    if (c.n < 3)
+        return "grid size must be at least 3";
+    if (c.max_iters < 0 || c.eps < 0)
+        return "max_iters and eps must not be negative";
+    if (c.threads < 0)
+        return "threads must not be negative";
+    const char* isa = c.simd != nullptr ? c.simd : "auto";
+    row = select_stencil_row(isa, &kernel_name);
+    if (row == nullptr)
+        return std::string("simd kernel ") + isa + " is not supported on this CPU";
+    // ядро под фиксированное n - только при автоматическом выборе, явный --simd важнее
+    if (!c.generic && std::strcmp(isa, "auto") == 0 && select_stencil_row_fixed(c.n) != nullptr) {
+        row = select_stencil_row_fixed(c.n);
+        kernel_name = "fixed";
+    }
+    cfg = c;
+    cfg.simd = nullptr; // строка вызывающего дальше не нужна
+    cur = alloc_grid(cfg);
+    next = alloc_grid(cfg);
+    if (cur == nullptr || next == nullptr) {
+        release();
+        return "out of memory";
+    }
+    return "";
+}
+
+size_t heat_solver::grid_bytes() const {
+    return grid_size(cfg);
+}
+
+heat_result heat_solver::solve() {
+    int iter = 0;
+    double error = cfg.eps + 1;
+    int m = cfg.n;
+    int threads = cfg.threads > 0 ? cfg.threads : omp_get_max_threads();
+    stencil_row_fn kernel = row;
+
+    while (error > cfg.eps && iter < cfg.max_iters) {
+        error = 0;
+        double* A = cur;
+        double* Anew = next;
+        TELEMETRY(telem, telemetry_iter_begin(*telem));
+
+        #pragma omp parallel num_threads(threads) reduction(max:error)
+        {
+            TELEMETRY(telem, telemetry_thread_begin(*telem));
+            #pragma omp for schedule(static) nowait
+            for (int i = 1; i < m - 1; i++) {
+                double row_error = kernel(A + (size_t)(i - 1) * m, A + (size_t)i * m, A + (size_t)(i + 1) * m,
+                                          Anew + (size_t)i * m, m);
+                error = row_error > error ? row_error : error;
+            }
+            TELEMETRY(telem, telemetry_thread_end(*telem));
+        }
+        std::swap(cur, next);
+
+        iter++;
+        TELEMETRY(telem, telemetry_iter_end(*telem, iter, error));
+    }
+
+    heat_result res;
+    res.iters = iter;
+    res.error = error;
+    return res;
+}
+
+heat_solver* heat_create(const heat_config* cfg, char* err, size_t err_len) {
+    heat_solver* s = new (std::nothrow) heat_solver();
+    std::string msg = s == nullptr ? "out of memory" : s->open(*cfg);
+    if (msg.empty())
+        return s;
+    if (err != nullptr && err_len > 0)
+        std::snprintf(err, err_len, "%s", msg.c_str());
+    delete s;
+    return nullptr;
+}
+
+heat_result heat_solve(heat_solver* s) {
+    return s->solve();
+}
+
+double* heat_grid(heat_solver* s) {
+    return s->grid();
+}
+
+const char* heat_kernel(const heat_solver* s) {
+    return s->kernel();
+}
+
+void heat_numa_report(const heat_solver* s, char* out, size_t out_len) {
+    if (out_len > 0)
+        std::snprintf(out, out_len, "%s", numa_report(s->grid(), s->grid_bytes()).c_str());
+}
+
+void heat_destroy(heat_solver* s) {
+    delete s;
+}
@@ -0,0 +1,82 @@
+#pragma once
+/* Решатель уравнения теплопроводности (двухсеточный Якоби) как библиотека.
+ * Вся конфигурация и обе сетки лежат в объекте heat_solver, глобальных
+ * переменных нет, так что разные решатели можно запускать одновременно из
+ * разных потоков. Один объект одновременно используется одним потоком.
+ * C++: heat_solver с open/solve/grid. C: непрозрачный heat_solver* и
+ * функции heat_*, файл подключается и из C. */
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct heat_config {
+    int n;             /* сетка n x n, n >= 3 */
+    int max_iters;
+    double eps;
+    double tl, tr, bl, br; /* температуры в углах, стороны - линейно */
+    int threads;       /* потоков OpenMP на решение, 0 - по умолчанию */
+    const char* simd;  /* "auto", "avx512", "avx2", "scalar"; NULL - auto */
+    int generic;       /* 1 - не брать ядра под фиксированные n */
+    int numa_bind;     /* 1 - закрепить полосы сетки за узлами NUMA их потоков */
+} heat_config;
+
+typedef struct heat_result {
+    int iters;
+    double error;
+} heat_result;
+
+#ifndef __cplusplus
+typedef struct heat_solver heat_solver;
+#endif
+
+/* n = 256, eps = 1e-6, углы 10 20 20 30, как у cpu по умолчанию */
+heat_config heat_default_config(void);
+/* NULL при ошибке, текст ошибки пишется в err (если err_len > 0) */
+struct heat_solver* heat_create(const heat_config* cfg, char* err, size_t err_len);
+heat_result heat_solve(struct heat_solver* s);
+/* текущее решение n x n по строкам; до solve - начальное приближение,
+ * его можно заполнить (граница должна остаться нетронутой) */
+double* heat_grid(struct heat_solver* s);
+const char* heat_kernel(const struct heat_solver* s);
+/* размещение сетки по узлам NUMA одной строкой, буфер от вызывающего */
+void heat_numa_report(const struct heat_solver* s, char* out, size_t out_len);
+void heat_destroy(struct heat_solver* s);
+
+#ifdef __cplusplus
+}
+
+#include <string>
+#include "stencil_simd.h"
+#include "telemetry.h"
+
+struct heat_solver {
+    heat_solver() = default;
+    heat_solver(const heat_solver&) = delete;
+    heat_solver& operator=(const heat_solver&) = delete;
+    ~heat_solver();
+
+    // текст ошибки, пустая строка - успех. Повторный open начинает заново
+    std::string open(const heat_config& cfg);
+    // итерации от текущего состояния сетки до eps или max_iters
+    heat_result solve();
+    double* grid() { return cur; }
+    const double* grid() const { return cur; }
+    int size() const { return cfg.n; }
+    const char* kernel() const { return kernel_name; }
+    size_t grid_bytes() const;
+    // запись телеметрии в tm, nullptr - выключить
+    void set_telemetry(telemetry* tm) { telem = tm; }
+
+private:
+    void release();
+
+    heat_config cfg = heat_default_config();
+    double* cur = nullptr;
+    double* next = nullptr;
+    stencil_row_fn row = nullptr;
+    const char* kernel_name = "";
+    telemetry* telem = nullptr;
+};
+#endif
@@ -0,0 +1,284 @@
+#include <iostream>
+#include <vector>
+#include <cstring>
+#include <mpi.h>
+#include <omp.h>
+#include <boost/program_options.hpp>
+
+
+// Якоби на нескольких процессах MPI: сетка n x n режется на блоки
+// py x px, у каждого блока своя рамка теневых ячеек шириной 1.
+// Обмен рамками неблокирующий: пока сообщения идут, считается внутренность
+// блока, которой рамка не нужна, затем после MPI_Waitall - края блока.
+// Глобальный max ошибки собирается MPI_Allreduce раз в check_every итераций.
+using vd = double*;
+int n, max_iters;
+double eps;
+int check_every;
+int px, py; // процессов по столбцам и строкам, 0 - выбрать самим
+double corners[4]; // tl tr bl br
+
+// блок этого процесса: строки [r0, r1) и столбцы [c0, c1) глобальной сетки,
+// локальная сетка (h + 2) x (w + 2) с рамкой
+int r0, r1, c0, c1, h, w;
+int north, south, west, east;
+MPI_Comm cart;
+MPI_Datatype column;
+
+#define lind(i, j) ((size_t)(i) * (w + 2) + (j))
+#define max(a, b) ((a) > (b) ? (a) : (b))
+#define abs(a) ((a) < 0 ? (0-(a)) : (a))
+
+// та же интерполяция, что у cpu, граница совпадает побитово
+std::vector<double> interpolation(double start, double end) {
+    std::vector<double> res(n);
+    double curr = start;
+    double dx = (end - start) / (n - 1);
+    for (int i = 0; i < n; i++) {
+        res[i] = curr;
+        curr += dx;
+    }
+    return res;
+}
+
+// локальный кусок начальной сетки: граница из углов, внутри нули;
+// nullptr, если не хватило памяти
+vd init_block() {
+    vd res = (vd)calloc((size_t)(h + 2) * (w + 2), sizeof(double));
+    if (res == nullptr)
+        return nullptr;
+    std::vector<double> top = interpolation(corners[0], corners[1]);
+    std::vector<double> left = interpolation(corners[0], corners[2]);
+    std::vector<double> right = interpolation(corners[1], corners[3]);
+    std::vector<double> bottom = interpolation(corners[2], corners[3]);
+    for (int i = r0; i < r1; i++) {
+        for (int j = c0; j < c1; j++) {
+            double v = 0;
+            if (i == 0)
+                v = top[j];
+            else if (i == n - 1)
+                v = bottom[j];
+            else if (j == 0)
+                v = left[i];
+            else if (j == n - 1)
+                v = right[i];
+            res[lind(i - r0 + 1, j - c0 + 1)] = v;
+        }
+    }
+    return res;
+}
+
+// обновление локального прямоугольника [i0, i1) x [j0, j1)
+double sweep_rect(vd A, vd Anew, int i0, int i1, int j0, int j1) {
+    double error = 0;
+    #pragma omp parallel for reduction(max:error) schedule(static) if ((i1 - i0) * (j1 - j0) > 16384)
+    for (int i = i0; i < i1; i++) {
+        for (int j = j0; j < j1; j++) {
+            Anew[lind(i, j)] = (A[lind(i - 1, j)] + A[lind(i + 1, j)] +
+                                A[lind(i, j - 1)] + A[lind(i, j + 1)]) * 0.25;
+            error = max(error, abs(Anew[lind(i, j)] - A[lind(i, j)]));
+        }
+    }
+    return error;
+}
+
+// один проход по блоку с обменом рамкой A, возвращает локальный max ошибки
+double sweep_block(vd A, vd Anew) {
+    MPI_Request req[8];
+    MPI_Irecv(A + lind(0, 1), w, MPI_DOUBLE, north, 0, cart, &req[0]);
+    MPI_Irecv(A + lind(h + 1, 1), w, MPI_DOUBLE, south, 1, cart, &req[1]);
+    MPI_Irecv(A + lind(1, 0), 1, column, west, 2, cart, &req[2]);
+    MPI_Irecv(A + lind(1, w + 1), 1, column, east, 3, cart, &req[3]);
+    MPI_Isend(A + lind(1, 1), w, MPI_DOUBLE, north, 1, cart, &req[4]);
+    MPI_Isend(A + lind(h, 1), w, MPI_DOUBLE, south, 0, cart, &req[5]);
+    MPI_Isend(A + lind(1, 1), 1, column, west, 3, cart, &req[6]);
+    MPI_Isend(A + lind(1, w), 1, column, east, 2, cart, &req[7]);
+
+    // обновляемые ячейки: все, кроме глобальной границы
+    int i0 = (r0 == 0 ? 1 : 0) + 1, i1 = (r1 == n ? h : h + 1);
+    int j0 = (c0 == 0 ? 1 : 0) + 1, j1 = (c1 == n ? w : w + 1);
+    // внутренность, не читающая рамку: локальные строки и столбцы 2 .. h-1 / w-1
+    int di0 = max(i0, 2), di1 = i1 < h ? i1 : h;
+    int dj0 = max(j0, 2), dj1 = j1 < w ? j1 : w;
+    double error = sweep_rect(A, Anew, di0, di1, dj0, dj1);
+
+    MPI_Waitall(8, req, MPI_STATUSES_IGNORE);
+
+    double e;
+    if (i0 <= 1 && 1 < i1) {
+        e = sweep_rect(A, Anew, 1, 2, j0, j1);
+        error = max(error, e);
+    }
+    if (h > 1 && i0 <= h && h < i1) {
+        e = sweep_rect(A, Anew, h, h + 1, j0, j1);
+        error = max(error, e);
+    }
+    if (j0 <= 1 && 1 < j1) {
+        e = sweep_rect(A, Anew, di0, di1, 1, 2);
+        error = max(error, e);
+    }
+    if (w > 1 && j0 <= w && w < j1) {
+        e = sweep_rect(A, Anew, di0, di1, w, w + 1);
+        error = max(error, e);
+    }
+    return error;
+}
+
+// Итерации до первой глобальной проверки с error <= eps: при check_every > 1
+// их может быть на check_every - 1 больше, чем у cpu
+std::pair<int, double> method_Jacobi(vd A, vd Anew, int& checks) {
+    int iter = 0;
+    double error = eps + 1;
+    checks = 0;
+
+    while (error > eps && iter < max_iters) {
+        double local = sweep_block(A, Anew);
+        std::swap(A, Anew);
+        iter++;
+        if (iter % check_every == 0 || iter == max_iters) {
+            MPI_Allreduce(&local, &error, 1, MPI_DOUBLE, MPI_MAX, cart);
+            checks++;
+        }
+    }
+
+    return std::make_pair(iter, error);
+}
+
+int parse_args(int argc, char** argv, bool verbose) {
+    boost::program_options::options_description desc("MPI Heat Equation Solver Options");
+    desc.add_options()
+        ("help", "help message")
+        ("n", boost::program_options::value<int>()->default_value(128), "grid size (n x n)")
+        ("eps", boost::program_options::value<double>()->default_value(1.0e-6), "precision")
+        ("iter", boost::program_options::value<int>()->default_value(1000000), "max iterations")
+        ("check", boost::program_options::value<int>()->default_value(100), "iterations between global error reductions")
+        ("px", boost::program_options::value<int>()->default_value(0), "ranks along columns (0 - auto)")
+        ("py", boost::program_options::value<int>()->default_value(0), "ranks along rows (0 - auto)")
+        ("corners", boost::program_options::value<std::vector<double>>()->multitoken()
+                        ->default_value(std::vector<double>{10, 20, 20, 30}, "10 20 20 30"),
+         "corner temperatures: top-left top-right bottom-left bottom-right");
+
+    boost::program_options::variables_map vm;
+    try {
+        boost::program_options::store(boost::program_options::parse_command_line(argc, argv, desc), vm);
+        boost::program_options::notify(vm);
+
+        if (vm.count("help")) {
+            if (verbose)
+                std::cout << desc << "\n";
+            return 1;
+        }
+
+        n = vm["n"].as<int>();
+        eps = vm["eps"].as<double>();
+        max_iters = vm["iter"].as<int>();
+        check_every = vm["check"].as<int>();
+        px = vm["px"].as<int>();
+        py = vm["py"].as<int>();
+        std::vector<double> c = vm["corners"].as<std::vector<double>>();
+        if (c.size() != 4) {
+            if (verbose)
+                std::cout << "Error: corners needs 4 values\n";
+            return 2;
+        }
+        for (int k = 0; k < 4; k++)
+            corners[k] = c[k];
+        if (n < 3 || check_every < 1 || px < 0 || py < 0) {
+            if (verbose)
+                std::cout << "Error: n must be at least 3, check and the rank grid positive\n";
+            return 2;
+        }
+    } catch (const std::exception& e) {
+        if (verbose)
+            std::cout << "Error: " << e.what() << "\n";
+        return 2;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    // sweep_rect открывает регионы OpenMP, MPI зовет только главный поток
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    if (provided < MPI_THREAD_FUNNELED) {
+        if (rank == 0)
+            std::cout << "Error: MPI library does not support MPI_THREAD_FUNNELED\n";
+        MPI_Finalize();
+        return 1;
+    }
+
+    switch (parse_args(argc, argv, rank == 0)) {
+        case 1:
+            MPI_Finalize();
+            return 0;
+        case 2:
+            MPI_Finalize();
+            return 1;
+        default:
+            break;
+    }
+
+    int dims[2] = {py, px};
+    bool fits = (px == 0 || size % px == 0) && (py == 0 || size % py == 0) &&
+                (px == 0 || py == 0 || px * py == size);
+    if (!fits || MPI_Dims_create(size, 2, dims) != MPI_SUCCESS || dims[0] > n || dims[1] > n) {
+        if (rank == 0)
+            std::cout << "Error: cannot split " << size << " ranks into a grid for n = " << n << "\n";
+        MPI_Finalize();
+        return 1;
+    }
+    py = dims[0];
+    px = dims[1];
+    int periods[2] = {0, 0};
+    MPI_Cart_create(MPI_COMM_WORLD, 2, dims, periods, 0, &cart);
+    int coords[2];
+    MPI_Cart_coords(cart, rank, 2, coords);
+    MPI_Cart_shift(cart, 0, 1, &north, &south);
+    MPI_Cart_shift(cart, 1, 1, &west, &east);
+    r0 = (int)((long long)n * coords[0] / py);
+    r1 = (int)((long long)n * (coords[0] + 1) / py);
+    c0 = (int)((long long)n * coords[1] / px);
+    c1 = (int)((long long)n * (coords[1] + 1) / px);
+    h = r1 - r0;
+    w = c1 - c0;
+    MPI_Type_vector(h, 1, w + 2, MPI_DOUBLE, &column);
+    MPI_Type_commit(&column);
+
+    vd A = init_block();
+    vd A_new = init_block();
+    // без памяти хотя бы у одного процесса остальные повисли бы на обмене
+    int ok = A != nullptr && A_new != nullptr, all_ok;
+    MPI_Allreduce(&ok, &all_ok, 1, MPI_INT, MPI_MIN, cart);
+    if (!all_ok) {
+        if (rank == 0)
+            std::cout << "Error: out of memory for the local blocks\n";
+        free(A);
+        free(A_new);
+        MPI_Type_free(&column);
+        MPI_Comm_free(&cart);
+        MPI_Finalize();
+        return 1;
+    }
+    MPI_Barrier(cart);
+    double start = MPI_Wtime();
+    int checks;
+    std::pair<int, double> res = method_Jacobi(A, A_new, checks);
+    double elapsed = MPI_Wtime() - start;
+    double slowest;
+    MPI_Reduce(&elapsed, &slowest, 1, MPI_DOUBLE, MPI_MAX, 0, cart);
+    if (rank == 0) {
+        std::cout << "Ranks: " << size << " (" << py << " x " << px << ")\n";
+        std::cout << "Iters: " << res.first << "\n";
+        std::cout << "Error: " << res.second << "\n";
+        std::cout << "Elapsed time: " << slowest << "\n";
+        std::cout << "Checks: " << checks << "\n";
+    }
+    free(A);
+    free(A_new);
+    MPI_Type_free(&column);
+    MPI_Comm_free(&cart);
+    MPI_Finalize();
+}
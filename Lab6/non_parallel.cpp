@@ -3,13 +3,17 @@
 #include <iostream>
 #include <iomanip>
 #include <chrono>
+#include <string>
 #include <boost/program_options.hpp>
+#include "stencil_simd.h"
 
 
 // using vd = std::vector<double>;
 using vd = double*;
 int n, max_iters;
 double eps;
+stencil_row_fn stencil_row; // ядро строки, выбирается по CPUID в parse_args
+const char* stencil_name;
 
 #define ind(i, j) ((i) * n + (j))
 #define max(a, b) ((a) > (b) ? (a) : (b))
@@ -63,11 +67,9 @@ std::pair<int, double> method_Jacobi(vd A, vd A_new) {
     while(error > eps && iter < max_iters) {
         error = 0;
         for (int i = 1; i < sub_n; i++) {
-            for (int j = 1; j < sub_n; j++) {
-                A_new[ind(i, j)] = (A[ind(i - 1, j)] + A[ind(i + 1, j)] + 
-                                    A[ind(i, j - 1)] + A[ind(i, j + 1)]) * 0.25;
-                error = max(error, abs(A_new[ind(i, j)] - A[ind(i, j)]));
-            }
+            double row_error = stencil_row(A + ind(i - 1, 0), A + ind(i, 0), A + ind(i + 1, 0),
+                                           A_new + ind(i, 0), n);
+            error = max(error, row_error);
         }
         // print_matrix(A);
         // print_matrix(A_new);
@@ -89,6 +91,7 @@ int parse_args(int argc, char** argv) {
         ("n", boost::program_options::value<int>()->default_value(256), "grid size")
         ("eps", boost::program_options::value<double>()->default_value(1.0e-6), "precision")
         ("iter", boost::program_options::value<int>()->default_value(1000000), "max iterations")
+        ("simd", boost::program_options::value<std::string>()->default_value("auto"), "stencil kernel: auto, avx512, avx2 or scalar")
         ("profile", "enable profiling");
     
     boost::program_options::variables_map vm;
@@ -104,6 +107,12 @@ int parse_args(int argc, char** argv) {
         n = vm["n"].as<int>();
         eps = vm["eps"].as<double>();
         max_iters = vm["iter"].as<int>();
+        std::string simd = vm["simd"].as<std::string>();
+        stencil_row = select_stencil_row(simd.c_str(), &stencil_name);
+        if (stencil_row == nullptr) {
+            std::cout << "Error: kernel " << simd << " is not supported on this CPU\n";
+            return 2;
+        }
         
         if (vm.count("profile")) {
             max_iters = 50;  // Для профилирования
@@ -135,6 +144,7 @@ int main(int argc, char** argv) {
     std::pair<int, double> res = method_Jacobi(A, A_new);
     auto end = std::chrono::steady_clock::now();
     std::chrono::duration<double> dur = end - start;
+    std::cout << "Kernel: " << stencil_name << "\n";
     std::cout << "Iters: " << res.first << "\n";
     std::cout << "Error: " << res.second << "\n";
     std::cout << "Elapsed time: " << dur.count() << "\n";
@@ -0,0 +1,116 @@
+#pragma once
+// Размещение сеток по узлам NUMA. Страница попадает на узел потока, который
+// первым ее коснулся, поэтому сетка обнуляется параллельно теми же полосами
+// строк, что и проходы (schedule(static) по строкам 1 .. m-2): каждый поток
+// потом читает свою полосу из локальной памяти. При bind полоса еще и
+// закрепляется за узлом потока через mbind, ядро ее не перенесет.
+// libnuma не нужна: mbind, move_pages и getcpu вызываются через syscall.
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <omp.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define NUMA_MPOL_BIND 2
+#define NUMA_MAX_NODES 1024
+#define NUMA_SAMPLE_PAGES 4096 // для отчета хватает выборки страниц
+
+// число узлов по /sys/devices/system/node/online ("0", "0-1", ...)
+inline int numa_node_count() {
+    FILE* f = std::fopen("/sys/devices/system/node/online", "r");
+    if (f == nullptr)
+        return 1;
+    int first = 0, last = 0;
+    int got = std::fscanf(f, "%d-%d", &first, &last);
+    std::fclose(f);
+    return got == 2 ? last + 1 : first + 1;
+}
+
+// узел, на котором сейчас выполняется поток, -1 - неизвестно
+inline int numa_current_node() {
+    unsigned cpu = 0, node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0)
+        return -1;
+    return (int)node;
+}
+
+// закрепить за узлом страницы, целиком лежащие в [p, p + bytes)
+inline bool numa_bind(void* p, size_t bytes, int node) {
+    if (node < 0 || node >= NUMA_MAX_NODES)
+        return false;
+    uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t begin = ((uintptr_t)p + page - 1) / page * page;
+    uintptr_t end = ((uintptr_t)p + bytes) / page * page;
+    if (end <= begin)
+        return true;
+    unsigned long mask[NUMA_MAX_NODES / (8 * sizeof(unsigned long))] = {0};
+    mask[node / (8 * sizeof(unsigned long))] |= 1UL << (node % (8 * sizeof(unsigned long)));
+    return syscall(SYS_mbind, begin, end - begin, NUMA_MPOL_BIND, mask, NUMA_MAX_NODES, 0) == 0;
+}
+
+// обнулить сетку m x m (и хвост до bytes) с первым касанием полосами
+// проходов; threads = 0 - команда по умолчанию
+inline void numa_first_touch(double* grid, int m, size_t bytes, int threads, bool bind) {
+    if (m < 3) {
+        std::memset(grid, 0, bytes);
+        return;
+    }
+    size_t row = (size_t)m * sizeof(double);
+    #pragma omp parallel num_threads(threads > 0 ? threads : omp_get_max_threads())
+    {
+        if (bind) {
+            int lo = m, hi = -1;
+            #pragma omp for schedule(static)
+            for (int i = 1; i < m - 1; i++) {
+                lo = i < lo ? i : lo;
+                hi = i > hi ? i : hi;
+            }
+            if (hi >= lo) {
+                size_t first = lo == 1 ? 0 : lo, last = hi == m - 2 ? m : hi + 1;
+                numa_bind(grid + first * m, (last - first) * row, numa_current_node());
+            }
+        }
+        #pragma omp for schedule(static)
+        for (int i = 1; i < m - 1; i++) {
+            size_t first = i == 1 ? 0 : i, last = i == m - 2 ? m : i + 1;
+            std::memset(grid + first * m, 0, (last - first) * row);
+        }
+    }
+    std::memset((char*)grid + (size_t)m * row, 0, bytes - (size_t)m * row);
+}
+
+// "N nodes, pages: node 0 50%, node 1 50%" по выборке страниц сетки
+inline std::string numa_report(const void* p, size_t bytes) {
+    int nodes = numa_node_count();
+    uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t begin = (uintptr_t)p / page * page;
+    size_t total = ((uintptr_t)p + bytes - begin + page - 1) / page;
+    size_t step = total > NUMA_SAMPLE_PAGES ? total / NUMA_SAMPLE_PAGES : 1;
+    std::vector<void*> pages;
+    for (size_t k = 0; k < total; k += step)
+        pages.push_back((void*)(begin + k * page));
+    std::vector<int> status(pages.size(), -1);
+    char head[64];
+    std::snprintf(head, sizeof(head), "%d node%s", nodes, nodes == 1 ? "" : "s");
+    if (syscall(SYS_move_pages, 0, pages.size(), pages.data(), nullptr, status.data(), 0) != 0)
+        return std::string(head) + ", page placement unavailable";
+    std::vector<size_t> count(nodes + 1, 0);
+    for (int s : status)
+        count[s >= 0 && s < nodes ? s : nodes]++;
+    std::string res = std::string(head) + ", pages:";
+    for (int node = 0; node <= nodes; node++) {
+        if (node == nodes && count[node] == 0)
+            break;
+        char part[64];
+        if (node < nodes)
+            std::snprintf(part, sizeof(part), "%s node %d %.0f%%", node == 0 ? "" : ",", node,
+                          100.0 * count[node] / pages.size());
+        else
+            std::snprintf(part, sizeof(part), ", unplaced %.0f%%", 100.0 * count[node] / pages.size());
+        res += part;
+    }
+    return res;
+}
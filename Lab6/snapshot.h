@@ -0,0 +1,109 @@
+#pragma once
+// Фоновая запись промежуточных сеток. Решатель отдает указатель на только
+// что вычисленную сетку, поток вывода сам переводит ее во float
+// (копирует из сетки, пока следующий проход ее только читает) и пишет кадр.
+// Формат файла: "JACFRAME", int m, затем кадры
+// { int iter; double error; float grid[m * m]; }.
+// Если поток еще пишет предыдущий кадр, новый пропускается - решатель
+// никогда не ждет диск.
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct snapshot_writer {
+    FILE* file = nullptr;
+    int m = 0;
+    std::vector<float> frame;
+    std::thread io;
+    std::mutex lock;
+    std::condition_variable wake;
+    const double* grid = nullptr; // сетка на копирование, nullptr - заданий нет
+    int iter = 0;
+    double error = 0;
+    bool stop = false;
+    std::atomic<bool> copied{true}; // сетку можно перезаписывать
+    std::atomic<bool> idle{true};   // поток свободен для нового кадра
+    int written = 0, dropped = 0;
+};
+
+inline void snapshot_loop(snapshot_writer& sw) {
+    size_t cells = (size_t)sw.m * sw.m;
+    while (true) {
+        const double* grid;
+        int iter;
+        double error;
+        {
+            std::unique_lock<std::mutex> guard(sw.lock);
+            sw.wake.wait(guard, [&sw]() { return sw.grid != nullptr || sw.stop; });
+            if (sw.grid == nullptr)
+                return;
+            grid = sw.grid;
+            iter = sw.iter;
+            error = sw.error;
+            sw.grid = nullptr;
+        }
+        for (size_t k = 0; k < cells; k++)
+            sw.frame[k] = (float)grid[k];
+        sw.copied = true;
+        std::fwrite(&iter, sizeof(iter), 1, sw.file);
+        std::fwrite(&error, sizeof(error), 1, sw.file);
+        std::fwrite(sw.frame.data(), sizeof(float), cells, sw.file);
+        sw.written++;
+        sw.idle = true;
+    }
+}
+
+// возвращает текст ошибки, пустая строка - успех
+inline std::string snapshot_open(snapshot_writer& sw, const std::string& path, int m) {
+    sw.file = std::fopen(path.c_str(), "wb");
+    if (sw.file == nullptr)
+        return "cannot open snapshot file " + path;
+    sw.m = m;
+    sw.frame.resize((size_t)m * m);
+    std::fwrite("JACFRAME", 1, 8, sw.file);
+    std::fwrite(&m, sizeof(m), 1, sw.file);
+    sw.io = std::thread(snapshot_loop, std::ref(sw));
+    return "";
+}
+
+// предложить кадр; false - поток занят, кадр пропущен.
+// При true сетку нельзя менять до snapshot_wait_copy
+inline bool snapshot_offer(snapshot_writer& sw, const double* grid, int iter, double error) {
+    if (!sw.idle) {
+        sw.dropped++;
+        return false;
+    }
+    sw.idle = false;
+    sw.copied = false;
+    {
+        std::lock_guard<std::mutex> guard(sw.lock);
+        sw.grid = grid;
+        sw.iter = iter;
+        sw.error = error;
+    }
+    sw.wake.notify_one();
+    return true;
+}
+
+inline void snapshot_wait_copy(snapshot_writer& sw) {
+    while (!sw.copied)
+        std::this_thread::yield();
+}
+
+inline void snapshot_close(snapshot_writer& sw) {
+    if (sw.io.joinable()) {
+        {
+            std::lock_guard<std::mutex> guard(sw.lock);
+            sw.stop = true;
+        }
+        sw.wake.notify_one();
+        sw.io.join();
+    }
+    if (sw.file != nullptr)
+        std::fclose(sw.file);
+    sw.file = nullptr;
+}
@@ -0,0 +1,159 @@
+#pragma once
+// Кэш сошедшихся решений на диске. Файл называется по хэшу размера сетки и
+// граничных значений, внутри: "JACCACHE", int m, профиль границы
+// (CACHE_PROFILE точек на каждую сторону, не зависит от m) и сетка m x m.
+// Для теплого старта берется запись с ближайшим профилем, ее сетка
+// пересчитывается на нужный размер билинейной интерполяцией.
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <dirent.h>
+
+#define CACHE_MAGIC "JACCACHE"
+#define CACHE_PROFILE 64
+#define CACHE_SUFFIX ".grid"
+
+// значение на стороне side (0 - верх, 1 - низ, 2 - лево, 3 - право)
+// в точке t из [0, 1], линейно между узлами
+inline double cache_side(const double* grid, int m, int side, double t) {
+    double x = t * (m - 1);
+    int k = (int)x < m - 1 ? (int)x : m - 2;
+    double a = x - k;
+    size_t p0, p1;
+    switch (side) {
+        case 0: p0 = k; p1 = k + 1; break;
+        case 1: p0 = (size_t)(m - 1) * m + k; p1 = p0 + 1; break;
+        case 2: p0 = (size_t)k * m; p1 = p0 + m; break;
+        default: p0 = (size_t)k * m + m - 1; p1 = p0 + m; break;
+    }
+    return (1 - a) * grid[p0] + a * grid[p1];
+}
+
+inline std::vector<double> cache_profile(const double* grid, int m) {
+    std::vector<double> profile(4 * CACHE_PROFILE);
+    for (int side = 0; side < 4; side++)
+        for (int k = 0; k < CACHE_PROFILE; k++)
+            profile[side * CACHE_PROFILE + k] = cache_side(grid, m, side, (double)k / (CACHE_PROFILE - 1));
+    return profile;
+}
+
+// FNV-1a по m и всем граничным узлам
+inline uint64_t cache_key(const double* grid, int m) {
+    uint64_t h = 1469598103934665603ULL;
+    auto mix = [&h](const void* data, size_t bytes) {
+        const unsigned char* p = (const unsigned char*)data;
+        for (size_t k = 0; k < bytes; k++) {
+            h ^= p[k];
+            h *= 1099511628211ULL;
+        }
+    };
+    mix(&m, sizeof(m));
+    for (int k = 0; k < m; k++) {
+        mix(&grid[k], sizeof(double));
+        mix(&grid[(size_t)(m - 1) * m + k], sizeof(double));
+        mix(&grid[(size_t)k * m], sizeof(double));
+        mix(&grid[(size_t)k * m + m - 1], sizeof(double));
+    }
+    return h;
+}
+
+inline bool cache_store(const std::string& dir, const double* grid, int m) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx", (unsigned long long)cache_key(grid, m));
+    std::string path = dir + "/" + name + CACHE_SUFFIX;
+    FILE* f = std::fopen(path.c_str(), "wb");
+    if (f == nullptr)
+        return false;
+    std::vector<double> profile = cache_profile(grid, m);
+    bool ok = std::fwrite(CACHE_MAGIC, 1, 8, f) == 8 &&
+              std::fwrite(&m, sizeof(m), 1, f) == 1 &&
+              std::fwrite(profile.data(), sizeof(double), profile.size(), f) == profile.size() &&
+              std::fwrite(grid, sizeof(double), (size_t)m * m, f) == (size_t)m * m;
+    return std::fclose(f) == 0 && ok;
+}
+
+// заголовок записи; false - не файл кэша
+inline bool cache_read_header(FILE* f, int& m, std::vector<double>& profile) {
+    char magic[8];
+    profile.resize(4 * CACHE_PROFILE);
+    return std::fread(magic, 1, 8, f) == 8 && std::memcmp(magic, CACHE_MAGIC, 8) == 0 &&
+           std::fread(&m, sizeof(m), 1, f) == 1 && m > 2 &&
+           std::fread(profile.data(), sizeof(double), profile.size(), f) == profile.size();
+}
+
+// ближайшая по профилю границы запись (максимум разности по точкам профиля),
+// при равенстве - с тем же размером сетки. false - кэш пуст
+inline bool cache_closest(const std::string& dir, const std::vector<double>& profile, int m,
+                          std::string& best_path, double& best_dist) {
+    DIR* d = opendir(dir.c_str());
+    if (d == nullptr)
+        return false;
+    bool found = false;
+    bool best_same_size = false;
+    std::vector<double> other;
+    while (struct dirent* e = readdir(d)) {
+        std::string name = e->d_name;
+        size_t sl = std::strlen(CACHE_SUFFIX);
+        if (name.size() <= sl || name.compare(name.size() - sl, sl, CACHE_SUFFIX) != 0)
+            continue;
+        std::string path = dir + "/" + name;
+        FILE* f = std::fopen(path.c_str(), "rb");
+        if (f == nullptr)
+            continue;
+        int other_m;
+        bool ok = cache_read_header(f, other_m, other);
+        std::fclose(f);
+        if (!ok)
+            continue;
+        double dist = 0;
+        for (size_t k = 0; k < profile.size(); k++) {
+            double diff = profile[k] - other[k];
+            diff = diff < 0 ? -diff : diff;
+            dist = diff > dist ? diff : dist;
+        }
+        bool same_size = other_m == m;
+        if (!found || dist < best_dist || (dist == best_dist && same_size && !best_same_size)) {
+            found = true;
+            best_path = path;
+            best_dist = dist;
+            best_same_size = same_size;
+        }
+    }
+    closedir(d);
+    return found;
+}
+
+inline bool cache_load(const std::string& path, std::vector<double>& grid, int& m) {
+    FILE* f = std::fopen(path.c_str(), "rb");
+    if (f == nullptr)
+        return false;
+    std::vector<double> profile;
+    bool ok = cache_read_header(f, m, profile);
+    if (ok) {
+        grid.resize((size_t)m * m);
+        ok = std::fread(grid.data(), sizeof(double), grid.size(), f) == grid.size();
+    }
+    std::fclose(f);
+    return ok;
+}
+
+// внутренность dst (md x md) билинейно из src (ms x ms), граница dst не трогается
+inline void cache_resample(const double* src, int ms, double* dst, int md) {
+    double ratio = (double)(ms - 1) / (md - 1);
+    #pragma omp parallel for schedule(static)
+    for (int i = 1; i < md - 1; i++) {
+        double x = i * ratio;
+        int I = (int)x < ms - 1 ? (int)x : ms - 2;
+        double a = x - I;
+        for (int j = 1; j < md - 1; j++) {
+            double y = j * ratio;
+            int J = (int)y < ms - 1 ? (int)y : ms - 2;
+            double b = y - J;
+            dst[(size_t)i * md + j] =
+                (1 - a) * ((1 - b) * src[(size_t)I * ms + J] + b * src[(size_t)I * ms + J + 1]) +
+                a * ((1 - b) * src[(size_t)(I + 1) * ms + J] + b * src[(size_t)(I + 1) * ms + J + 1]);
+        }
+    }
+}
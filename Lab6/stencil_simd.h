@@ -0,0 +1,167 @@
+#pragma once
+// Ядро 5-точечного шаблона для одной строки, совмещенное с max|Anew - A|.
+// Варианты AVX-512, AVX2 и скалярный, выбор по CPUID при старте.
+// Порядок сложения как в обычном цикле, FMA не используется,
+// поэтому все варианты дают побитово одинаковый результат.
+#include <cstring>
+#include <immintrin.h>
+
+// up, mid, down - строки i-1, i, i+1 старой сетки, out - строка i новой;
+// обновляются элементы 1..m-2, возвращается максимум |out[j] - mid[j]|
+typedef double (*stencil_row_fn)(const double* up, const double* mid, const double* down,
+                                  double* out, int m);
+
+// nvc++ не умеет target-атрибуты, там векторные варианты собираются
+// только если их разрешают флаги компиляции (-tp, TP в makefile), выбора по
+// CPUID нет; его дает сборка g++ (цель cpu_dispatch)
+// STENCIL_CLONES - для циклов, которые векторизует сам компилятор:
+// GCC собирает копии под AVX-512/AVX2 и выбирает по CPUID при загрузке
+#if defined(__NVCOMPILER) || defined(__PGI)
+#define STENCIL_TARGET(isa)
+#define STENCIL_CLONES
+#define STENCIL_HAVE_CLONES 0
+#ifdef __AVX2__
+#define STENCIL_HAVE_AVX2 1
+#else
+#define STENCIL_HAVE_AVX2 0
+#endif
+#ifdef __AVX512F__
+#define STENCIL_HAVE_AVX512 1
+#else
+#define STENCIL_HAVE_AVX512 0
+#endif
+#else
+#define STENCIL_TARGET(isa) __attribute__((target(isa)))
+#define STENCIL_CLONES __attribute__((target_clones("avx512f", "avx2", "default")))
+#define STENCIL_HAVE_CLONES 1
+#define STENCIL_HAVE_AVX2 1
+#define STENCIL_HAVE_AVX512 1
+#endif
+
+inline double stencil_row_scalar(const double* up, const double* mid, const double* down,
+                                 double* out, int m) {
+    double error = 0;
+    for (int j = 1; j < m - 1; j++) {
+        out[j] = (up[j] + down[j] + mid[j - 1] + mid[j + 1]) * 0.25;
+        double d = out[j] - mid[j];
+        d = d < 0 ? -d : d;
+        error = d > error ? d : error;
+    }
+    return error;
+}
+
+#if STENCIL_HAVE_AVX2
+STENCIL_TARGET("avx2")
+inline double stencil_row_avx2(const double* up, const double* mid, const double* down,
+                               double* out, int m) {
+    const __m256d quarter = _mm256_set1_pd(0.25);
+    const __m256d sign = _mm256_set1_pd(-0.0);
+    __m256d verr = _mm256_setzero_pd();
+    int j = 1;
+    for (; j + 4 <= m - 1; j += 4) {
+        __m256d s = _mm256_add_pd(_mm256_loadu_pd(up + j), _mm256_loadu_pd(down + j));
+        s = _mm256_add_pd(s, _mm256_loadu_pd(mid + j - 1));
+        s = _mm256_add_pd(s, _mm256_loadu_pd(mid + j + 1));
+        s = _mm256_mul_pd(s, quarter);
+        _mm256_storeu_pd(out + j, s);
+        __m256d d = _mm256_andnot_pd(sign, _mm256_sub_pd(s, _mm256_loadu_pd(mid + j)));
+        verr = _mm256_max_pd(verr, d);
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, verr);
+    double error = lanes[0];
+    for (int k = 1; k < 4; k++)
+        error = lanes[k] > error ? lanes[k] : error;
+    // хвост строки
+    double tail = stencil_row_scalar(up + j - 1, mid + j - 1, down + j - 1, out + j - 1, m - j + 1);
+    return tail > error ? tail : error;
+}
+#endif
+
+#if STENCIL_HAVE_AVX512
+STENCIL_TARGET("avx512f")
+inline double stencil_row_avx512(const double* up, const double* mid, const double* down,
+                                 double* out, int m) {
+    const __m512d quarter = _mm512_set1_pd(0.25);
+    __m512d verr = _mm512_setzero_pd();
+    int j = 1;
+    for (; j + 8 <= m - 1; j += 8) {
+        __m512d s = _mm512_add_pd(_mm512_loadu_pd(up + j), _mm512_loadu_pd(down + j));
+        s = _mm512_add_pd(s, _mm512_loadu_pd(mid + j - 1));
+        s = _mm512_add_pd(s, _mm512_loadu_pd(mid + j + 1));
+        s = _mm512_mul_pd(s, quarter);
+        _mm512_storeu_pd(out + j, s);
+        __m512d d = _mm512_abs_pd(_mm512_sub_pd(s, _mm512_loadu_pd(mid + j)));
+        verr = _mm512_max_pd(verr, d);
+    }
+    double error = _mm512_reduce_max_pd(verr);
+    double tail = stencil_row_scalar(up + j - 1, mid + j - 1, down + j - 1, out + j - 1, m - j + 1);
+    return tail > error ? tail : error;
+}
+#endif
+
+// isa: "auto", "avx512", "avx2" или "scalar"; в name пишется выбранный вариант.
+// Если запрошенный набор инструкций не поддерживается, возвращается nullptr
+inline stencil_row_fn select_stencil_row(const char* isa, const char** name) {
+    bool is_auto = std::strcmp(isa, "auto") == 0;
+#if STENCIL_HAVE_AVX512
+    if ((is_auto || std::strcmp(isa, "avx512") == 0) && __builtin_cpu_supports("avx512f")) {
+        *name = "avx512";
+        return stencil_row_avx512;
+    }
+#endif
+#if STENCIL_HAVE_AVX2
+    if ((is_auto || std::strcmp(isa, "avx2") == 0) && __builtin_cpu_supports("avx2")) {
+        *name = "avx2";
+        return stencil_row_avx2;
+    }
+#endif
+    if (is_auto || std::strcmp(isa, "scalar") == 0) {
+        *name = "scalar";
+        return stencil_row_scalar;
+    }
+    return nullptr;
+}
+
+#define STENCIL_ALIGN 64
+
+// строка при m = N, известном на этапе компиляции: шаг и число итераций
+// постоянны, строки выровнены на STENCIL_ALIGN, так что цикл
+// разворачивается и векторизуется без хвостов. Порядок сложения тот же,
+// результат побитово совпадает с остальными вариантами
+template <int N>
+STENCIL_CLONES
+double stencil_row_fixed(const double* up, const double* mid, const double* down, double* out, int) {
+    up = (const double*)__builtin_assume_aligned(up, STENCIL_ALIGN);
+    mid = (const double*)__builtin_assume_aligned(mid, STENCIL_ALIGN);
+    down = (const double*)__builtin_assume_aligned(down, STENCIL_ALIGN);
+    out = (double*)__builtin_assume_aligned(out, STENCIL_ALIGN);
+    double error = 0;
+    #pragma omp simd reduction(max:error)
+    for (int j = 1; j < N - 1; j++) {
+        double v = (up[j] + down[j] + mid[j - 1] + mid[j + 1]) * 0.25;
+        out[j] = v;
+        double d = v - mid[j];
+        d = d < 0 ? -d : d;
+        error = d > error ? d : error;
+    }
+    return error;
+}
+
+// специализация под m из набора 128 ... 4096, иначе nullptr. Без копий
+// под AVX-512/AVX2 (nvc++) она собрана только под базовый набор команд
+// и проиграла бы select_stencil_row, поэтому тогда тоже nullptr.
+// Вызывающий отвечает за выравнивание строк
+inline stencil_row_fn select_stencil_row_fixed(int m) {
+    if (!STENCIL_HAVE_CLONES)
+        return nullptr;
+    switch (m) {
+        case 128: return stencil_row_fixed<128>;
+        case 256: return stencil_row_fixed<256>;
+        case 512: return stencil_row_fixed<512>;
+        case 1024: return stencil_row_fixed<1024>;
+        case 2048: return stencil_row_fixed<2048>;
+        case 4096: return stencil_row_fixed<4096>;
+        default: return nullptr;
+    }
+}
@@ -0,0 +1,139 @@
+#pragma once
+// Телеметрия проходов Якоби: отметки времени каждой итерации в кольцевом
+// буфере (хранятся последние TELEMETRY_RING), ошибка итерации и время работы
+// каждого потока внутри прохода. По ним видно, где потеряно время:
+// thread_max - само ядро на самом медленном потоке, sweep - thread_max -
+// fork/join и редукция, thread_max / thread_mean - дисбаланс потоков.
+// Сборка с -DNO_TELEMETRY убирает все вызовы TELEMETRY из решателя.
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <omp.h>
+
+#define TELEMETRY_RING 4096
+#define TELEMETRY_PAD 8 // double на кэш-линию, у каждого потока своя
+// трафик памяти на ячейку: чтение A, запись Anew и ее чтение перед записью;
+// соседние строки берутся из кэша
+#define TELEMETRY_BYTES_PER_CELL 24
+// 3 сложения и умножение шаблона, разность и max ошибки не считаются
+#define TELEMETRY_FLOPS_PER_CELL 4
+
+#ifdef NO_TELEMETRY
+#define TELEMETRY(tm, call)
+#else
+#define TELEMETRY(tm, call) do { if ((tm) != nullptr) call; } while (0)
+#endif
+
+struct telemetry_sample {
+    int iter;
+    double start;       // от начала счета, с
+    double sweep;       // длительность прохода, с
+    double error;
+    double thread_max;  // время работы потоков внутри прохода, с
+    double thread_mean;
+};
+
+struct telemetry {
+    int m = 0;
+    int team = 1;
+    double t0 = 0, iter_start = 0;
+    long long iters = 0;
+    double total_sweep = 0, total_thread_max = 0, total_thread_mean = 0;
+    std::vector<telemetry_sample> ring;
+    std::vector<double> thread_begin, thread_time;
+};
+
+inline void telemetry_init(telemetry& tm, int m) {
+    tm.m = m;
+    tm.ring.resize(TELEMETRY_RING);
+    int threads = omp_get_max_threads();
+    tm.thread_begin.assign((size_t)threads * TELEMETRY_PAD, 0.0);
+    tm.thread_time.assign((size_t)threads * TELEMETRY_PAD, 0.0);
+    tm.t0 = omp_get_wtime();
+}
+
+inline void telemetry_iter_begin(telemetry& tm) {
+    tm.iter_start = omp_get_wtime();
+}
+
+// вызывается каждым потоком в начале и в конце своей части прохода;
+// потоки сверх omp_get_max_threads() на момент telemetry_init не учитываются
+inline void telemetry_thread_begin(telemetry& tm) {
+    size_t t = (size_t)omp_get_thread_num() * TELEMETRY_PAD;
+    if (t == 0)
+        tm.team = omp_get_num_threads() < (int)(tm.thread_time.size() / TELEMETRY_PAD)
+                      ? omp_get_num_threads() : (int)(tm.thread_time.size() / TELEMETRY_PAD);
+    if (t < tm.thread_begin.size())
+        tm.thread_begin[t] = omp_get_wtime();
+}
+
+inline void telemetry_thread_end(telemetry& tm) {
+    size_t t = (size_t)omp_get_thread_num() * TELEMETRY_PAD;
+    if (t < tm.thread_time.size())
+        tm.thread_time[t] = omp_get_wtime() - tm.thread_begin[t];
+}
+
+// без вызовов telemetry_thread_* проход считается однопоточным
+inline void telemetry_iter_end(telemetry& tm, int iter, double error) {
+    double now = omp_get_wtime();
+    telemetry_sample& s = tm.ring[tm.iters % TELEMETRY_RING];
+    s.iter = iter;
+    s.start = tm.iter_start - tm.t0;
+    s.sweep = now - tm.iter_start;
+    s.error = error;
+    s.thread_max = s.thread_mean = 0;
+    for (int t = 0; t < tm.team; t++) {
+        double tt = tm.thread_time[(size_t)t * TELEMETRY_PAD];
+        s.thread_max = tt > s.thread_max ? tt : s.thread_max;
+        s.thread_mean += tt / tm.team;
+        tm.thread_time[(size_t)t * TELEMETRY_PAD] = 0;
+    }
+    if (s.thread_max == 0)
+        s.thread_max = s.thread_mean = s.sweep;
+    tm.iters++;
+    tm.total_sweep += s.sweep;
+    tm.total_thread_max += s.thread_max;
+    tm.total_thread_mean += s.thread_mean;
+}
+
+// path с суффиксом .csv - CSV (сводка в строках-комментариях), иначе JSON.
+// false - файл не записан
+inline bool telemetry_dump(const telemetry& tm, const std::string& path) {
+    FILE* f = std::fopen(path.c_str(), "w");
+    if (f == nullptr)
+        return false;
+    bool csv = path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv") == 0;
+    double cells = (double)(tm.m - 2) * (tm.m - 2);
+    double sweep = tm.iters > 0 ? tm.total_sweep / tm.iters : 0;
+    double gbs = sweep > 0 ? cells * TELEMETRY_BYTES_PER_CELL / sweep * 1e-9 : 0;
+    double gflops = sweep > 0 ? cells * TELEMETRY_FLOPS_PER_CELL / sweep * 1e-9 : 0;
+    double imbalance = tm.total_thread_mean > 0 ? tm.total_thread_max / tm.total_thread_mean : 1;
+    double overhead = tm.total_sweep > 0 ? 1 - tm.total_thread_max / tm.total_sweep : 0;
+    long long first = tm.iters > TELEMETRY_RING ? tm.iters - TELEMETRY_RING : 0;
+
+    if (csv) {
+        std::fprintf(f, "# n=%d iters=%lld threads=%d sweep_s=%.9g gb_s=%.6g gflop_s=%.6g imbalance=%.6g overhead=%.6g\n",
+                     tm.m, tm.iters, tm.team, sweep, gbs, gflops, imbalance, overhead);
+        std::fprintf(f, "iter,start_s,sweep_s,error,thread_max_s,thread_mean_s,gb_s,gflop_s\n");
+    } else {
+        std::fprintf(f, "{\n  \"n\": %d,\n  \"iters\": %lld,\n  \"threads\": %d,\n", tm.m, tm.iters, tm.team);
+        std::fprintf(f, "  \"sweep_s\": %.9g,\n  \"gb_s\": %.6g,\n  \"gflop_s\": %.6g,\n", sweep, gbs, gflops);
+        std::fprintf(f, "  \"imbalance\": %.6g,\n  \"overhead\": %.6g,\n  \"samples\": [", imbalance, overhead);
+    }
+    for (long long k = first; k < tm.iters; k++) {
+        const telemetry_sample& s = tm.ring[k % TELEMETRY_RING];
+        double sgbs = s.sweep > 0 ? cells * TELEMETRY_BYTES_PER_CELL / s.sweep * 1e-9 : 0;
+        double sgflops = s.sweep > 0 ? cells * TELEMETRY_FLOPS_PER_CELL / s.sweep * 1e-9 : 0;
+        if (csv)
+            std::fprintf(f, "%d,%.9g,%.9g,%.9g,%.9g,%.9g,%.6g,%.6g\n", s.iter, s.start, s.sweep, s.error,
+                         s.thread_max, s.thread_mean, sgbs, sgflops);
+        else
+            std::fprintf(f, "%s\n    {\"iter\": %d, \"start_s\": %.9g, \"sweep_s\": %.9g, \"error\": %.9g, "
+                            "\"thread_max_s\": %.9g, \"thread_mean_s\": %.9g, \"gb_s\": %.6g, \"gflop_s\": %.6g}",
+                         k == first ? "" : ",", s.iter, s.start, s.sweep, s.error, s.thread_max, s.thread_mean,
+                         sgbs, sgflops);
+    }
+    if (!csv)
+        std::fprintf(f, "\n  ]\n}\n");
+    return std::fclose(f) == 0;
+}
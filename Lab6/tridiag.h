@@ -0,0 +1,50 @@
+#pragma once
+// Пакетный метод прогонки (Томаса) для многих трехдиагональных систем
+// с одинаковыми постоянными коэффициентами:
+//   a x_{k-1} + b x_k + c x_{k+1} = d_k,  k = 0 .. len-1.
+// Прогоночные коэффициенты от правой части не зависят и считаются один раз.
+// Системы лежат рядом: элемент k системы s - d[k * stride + s], поэтому
+// на каждом шаге прогонки внутренний цикл идет по системам подряд в памяти
+// и векторизуется, а рекуррентность по k остается во внешнем цикле.
+#include <vector>
+
+class tridiag_plan {
+public:
+    tridiag_plan(int len, double a, double b, double c) : len(len), a(a), cp(len), inv(len) {
+        inv[0] = 1 / b;
+        cp[0] = c * inv[0];
+        for (int k = 1; k < len; k++) {
+            inv[k] = 1 / (b - a * cp[k - 1]);
+            cp[k] = c * inv[k];
+        }
+    }
+
+    // решить системы s из [s0, s1) на месте: d превращается в x
+    void solve(double* d, long stride, int s0, int s1) const {
+        double* row = d;
+        #pragma omp simd
+        for (int s = s0; s < s1; s++)
+            row[s] *= inv[0];
+        for (int k = 1; k < len; k++) {
+            double* prev = row;
+            row = d + k * stride;
+            double ik = inv[k];
+            #pragma omp simd
+            for (int s = s0; s < s1; s++)
+                row[s] = (row[s] - a * prev[s]) * ik;
+        }
+        for (int k = len - 2; k >= 0; k--) {
+            double* next = row;
+            row = d + k * stride;
+            double ck = cp[k];
+            #pragma omp simd
+            for (int s = s0; s < s1; s++)
+                row[s] -= ck * next[s];
+        }
+    }
+
+private:
+    int len;
+    double a;
+    std::vector<double> cp, inv;
+};
@@ -0,0 +1,262 @@
+#pragma once
+// Тонкая прослойка между graph.cu и платформой: память устройства, запуск
+// ядра по сетке блоков, захват потока в граф и его повтор, max-редукция и
+// метки nvtx. По умолчанию все идет в CUDA/cub/nvtx (nvc++), с -DDEVICE_HOST
+// тот же исходник собирается обычным компилятором C++ с OpenMP:
+//  - "память устройства" - обычная память хоста, копирование - memcpy;
+//  - ядро __global__ - обычная функция, blockIdx/threadIdx/blockDim/gridDim -
+//    переменные потока, запуск проходит все блоки параллельно (omp for),
+//    а нити блока - по порядку внутри потока OpenMP;
+//  - поток выполняет операции сразу, в режиме захвата - складывает их в граф,
+//    повтор графа выполняет их по порядку;
+//  - метки nvtx ничего не делают.
+// Ядра запускаются макросом DEVICE_LAUNCH(kernel, grid, block, stream, args...)
+// вместо kernel<<<grid, block, 0, stream>>>(args...).
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+
+#ifndef DEVICE_HOST
+#include <nvtx3/nvToolsExt.h>
+#include <cuda_runtime.h>
+#include <cub/cub.cuh>
+#else
+#include <vector>
+#include <omp.h>
+#endif
+
+inline void f_exception(std::string message) {
+    printf("%s!\n", message.c_str());
+    exit(2);
+}
+
+// указатель для управления памятью на устройстве
+template<typename T>
+using cuda_unique_ptr = std::unique_ptr<T, std::function<void(T*)>>;
+
+#ifndef DEVICE_HOST
+
+#define DEVICE_LAUNCH(kernel, grid, block, stream, ...) kernel<<<grid, block, 0, stream>>>(__VA_ARGS__)
+
+using device_stream = cudaStream_t;
+
+struct device_graph {
+    cudaGraph_t graph;
+    cudaGraphExec_t instance;
+};
+
+// выделение памяти на устройстве
+template<typename T>
+T* cuda_new(size_t size) {
+    T *d_ptr;
+    cudaError_t status;
+    status = cudaMalloc((void **)&d_ptr, sizeof(T) * size);
+    if (status != cudaSuccess) f_exception(std::string("cudaMalloc error"));
+    return d_ptr;
+}
+// освобождение ресурсов
+template<typename T>
+void cuda_free(T *dev_ptr) {
+    cudaError_t status;
+    status = cudaFree(dev_ptr);
+    if (status != cudaSuccess) f_exception(std::string("cudaFree error"));
+}
+
+template<typename T>
+void copy_to_device(T* d_dst, const T* src, size_t size) {
+    if (cudaMemcpy(d_dst, src, size * sizeof(T), cudaMemcpyHostToDevice) != cudaSuccess)
+        f_exception(std::string("cudaMemcpy error"));
+}
+
+template<typename T>
+void copy_to_host(T* dst, const T* d_src, size_t size) {
+    if (cudaMemcpy(dst, d_src, size * sizeof(T), cudaMemcpyDeviceToHost) != cudaSuccess)
+        f_exception(std::string("cudaMemcpy error"));
+}
+
+inline device_stream stream_create() {
+    cudaStream_t stream;
+    if (cudaStreamCreate(&stream) != cudaSuccess) f_exception(std::string("cudaStreamCreate error"));
+    return stream;
+}
+
+inline void stream_destroy(device_stream stream) {
+    cudaStreamDestroy(stream);
+}
+
+// начало захвата операций на потоке stream
+inline void graph_capture_begin(device_stream stream) {
+    if (cudaStreamBeginCapture(stream, cudaStreamCaptureModeGlobal) != cudaSuccess)
+        f_exception(std::string("cudaStreamBeginCapture error"));
+}
+
+// завершение захвата и создание исполняемого графа
+inline void graph_capture_end(device_stream stream, device_graph& g) {
+    if (cudaStreamEndCapture(stream, &g.graph) != cudaSuccess)
+        f_exception(std::string("cudaStreamEndCapture error"));
+    if (cudaGraphInstantiate(&g.instance, g.graph, NULL, NULL, 0) != cudaSuccess)
+        f_exception(std::string("cudaGraphInstantiate error"));
+}
+
+inline void graph_launch(const device_graph& g, device_stream stream) {
+    if (cudaGraphLaunch(g.instance, stream) != cudaSuccess) f_exception(std::string("cudaGraphLaunch error"));
+}
+
+inline void graph_destroy(device_graph& g) {
+    cudaGraphExecDestroy(g.instance);
+    cudaGraphDestroy(g.graph);
+}
+
+// max по count элементам в d_out, временная память cub выделяется один раз
+struct device_max {
+    cuda_unique_ptr<char> temp;
+    size_t temp_bytes = 0;
+
+    device_max(const double* d_in, double* d_out, int count, device_stream stream) {
+        cub::DeviceReduce::Max(nullptr, temp_bytes, d_in, d_out, count, stream);
+        temp = cuda_unique_ptr<char>(cuda_new<char>(temp_bytes), cuda_free<char>);
+    }
+
+    void operator()(const double* d_in, double* d_out, int count, device_stream stream) {
+        cub::DeviceReduce::Max(temp.get(), temp_bytes, d_in, d_out, count, stream);
+    }
+};
+
+inline void range_push(const char* name) {
+    nvtxRangePushA(name);
+}
+
+inline void range_pop() {
+    nvtxRangePop();
+}
+
+#else
+
+#define __global__
+#define DEVICE_LAUNCH(kernel, grid, block, stream, ...) \
+    device_launch(grid, block, stream, [=] { kernel(__VA_ARGS__); })
+
+struct dim3 {
+    unsigned x, y, z;
+    dim3(unsigned x = 1, unsigned y = 1, unsigned z = 1) : x(x), y(y), z(z) {}
+};
+
+// координаты "нити" ядра, у каждого потока OpenMP свои
+static thread_local dim3 blockIdx, threadIdx, blockDim, gridDim;
+
+struct device_graph {
+    std::vector<std::function<void()>> ops;
+};
+
+struct host_stream {
+    device_graph* capture = nullptr; // граф, в который идет захват
+    device_graph captured;
+};
+using device_stream = host_stream*;
+
+template<typename T>
+T* cuda_new(size_t size) {
+    T* ptr = (T*)std::malloc(sizeof(T) * size);
+    if (ptr == nullptr && size > 0) f_exception(std::string("host allocation error"));
+    return ptr;
+}
+
+template<typename T>
+void cuda_free(T *ptr) {
+    std::free(ptr);
+}
+
+template<typename T>
+void copy_to_device(T* d_dst, const T* src, size_t size) {
+    std::memcpy(d_dst, src, size * sizeof(T));
+}
+
+template<typename T>
+void copy_to_host(T* dst, const T* d_src, size_t size) {
+    std::memcpy(dst, d_src, size * sizeof(T));
+}
+
+inline device_stream stream_create() {
+    return new host_stream();
+}
+
+inline void stream_destroy(device_stream stream) {
+    delete stream;
+}
+
+// выполнить op на потоке: сразу или в захватываемый граф
+inline void stream_enqueue(device_stream stream, std::function<void()> op) {
+    if (stream->capture != nullptr)
+        stream->capture->ops.push_back(std::move(op));
+    else
+        op();
+}
+
+// блоки сетки делятся между потоками OpenMP, нити блока идут по порядку,
+// x - самый внутренний, как соседние нити варпа
+template<typename F>
+void device_launch(dim3 grid, dim3 block, device_stream stream, F body) {
+    stream_enqueue(stream, [=] {
+        #pragma omp parallel for collapse(3) schedule(static)
+        for (unsigned bz = 0; bz < grid.z; bz++) {
+            for (unsigned by = 0; by < grid.y; by++) {
+                for (unsigned bx = 0; bx < grid.x; bx++) {
+                    gridDim = grid;
+                    blockDim = block;
+                    blockIdx = dim3(bx, by, bz);
+                    for (unsigned tz = 0; tz < block.z; tz++)
+                        for (unsigned ty = 0; ty < block.y; ty++)
+                            for (unsigned tx = 0; tx < block.x; tx++) {
+                                threadIdx = dim3(tx, ty, tz);
+                                body();
+                            }
+                }
+            }
+        }
+    });
+}
+
+inline void graph_capture_begin(device_stream stream) {
+    if (stream->capture != nullptr) f_exception(std::string("stream is already capturing"));
+    stream->captured.ops.clear();
+    stream->capture = &stream->captured;
+}
+
+inline void graph_capture_end(device_stream stream, device_graph& g) {
+    if (stream->capture == nullptr) f_exception(std::string("stream is not capturing"));
+    g.ops = std::move(stream->captured.ops);
+    stream->captured.ops.clear();
+    stream->capture = nullptr;
+}
+
+inline void graph_launch(const device_graph& g, device_stream stream) {
+    if (stream->capture != nullptr) f_exception(std::string("graph launch during capture"));
+    for (const std::function<void()>& op : g.ops)
+        op();
+}
+
+inline void graph_destroy(device_graph& g) {
+    g.ops.clear();
+}
+
+struct device_max {
+    device_max(const double*, double*, int, device_stream) {}
+
+    void operator()(const double* d_in, double* d_out, int count, device_stream stream) {
+        stream_enqueue(stream, [=] {
+            double res = d_in[0];
+            #pragma omp parallel for reduction(max:res) schedule(static)
+            for (int k = 1; k < count; k++)
+                res = d_in[k] > res ? d_in[k] : res;
+            *d_out = res;
+        });
+    }
+};
+
+inline void range_push(const char*) {}
+inline void range_pop() {}
+
+#endif
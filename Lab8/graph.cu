@@ -1,18 +1,13 @@
 #include <iostream>
 #include <boost/program_options.hpp>
 #include <new>
-#include <nvtx3/nvToolsExt.h>
 #include <chrono>
 #include <cmath>
 #include <cstdlib>
 #include <cstring>
 #include <iomanip>
 #include <fstream>
-#include <cuda_runtime.h>
-#include <cub/cub.cuh>
-#include <cub/block/block_load.cuh>
-#include <cub/block/block_reduce.cuh>
-#include <cub/block/block_store.cuh>
+#include "device_port.h"
 
 
 using vd = double*;
@@ -24,31 +19,11 @@ double eps;
 #define max(a, b) ((a) > (b) ? (a) : (b))
 #define abs(a) ((a) < 0 ? (0-(a)) : (a))
 #define graph_step 512
+#define block_side 32
 
-// указатель для управления памятью на устройстве
-template<typename T>
-using cuda_unique_ptr = std::unique_ptr<T, std::function<void(T*)>>;
-
-void f_exception(std::string message) {
-    printf("%s!\n", message.c_str());
-    exit(2);
-}
-
-// выделение памяти на устройстве
-template<typename T>
-T* cuda_new(size_t size) {
-    T *d_ptr;
-    cudaError_t status;
-    status = cudaMalloc((void **)&d_ptr, sizeof(T) * size);
-    if (status != cudaSuccess) f_exception(std::string("cudaMalloc error"));
-    return d_ptr;
-}
-// освобождение ресурсов
-template<typename T>
-void cuda_free(T *dev_ptr) {
-    cudaError_t status;
-    status = cudaFree(dev_ptr);
-    if (status != cudaSuccess) f_exception(std::string("cudaFree error"));
+// сетка блоков block_side x block_side, покрывающая матрицу m x m
+dim3 cover_grid(int m) {
+    return dim3((m + block_side - 1) / block_side, (m + block_side - 1) / block_side);
 }
 
 __global__ void sub_mats(const double *A, const double *Anew, double *subtr_res, int m) {
@@ -74,7 +49,7 @@ __global__ void calc_mean(double *A, double *Anew, int m, bool flag) {
 }
 
 void init_grids(std::unique_ptr<double[]> &A, std::unique_ptr<double[]> &Anew) {
-    nvtxRangePushA("init");
+    range_push("init");
     memset(A.get(), 0, n * n * sizeof(double));
     //  10 ... 20
     // ... ... ...
@@ -91,26 +66,19 @@ void init_grids(std::unique_ptr<double[]> &A, std::unique_ptr<double[]> &Anew) {
         A[ind(n - 1, i)] = 20.0 + dx * (double)i;
     }
     std::memcpy(Anew.get(), A.get(), n * n * sizeof(double));
-    nvtxRangePop();
+    range_pop();
 }
 
-void create_graph(cudaStream_t& stream, cudaGraph_t& graph, cudaGraphExec_t& instance, double* d_A, double* d_Anew) {
-    cudaError_t cudaErr = cudaSuccess;
-    dim3 grid(32, 32);
-    dim3 block(32, 32);
-    nvtxRangePushA("createGraph");
-    // начало захвата операций на потоке stream
-    cudaErr = cudaStreamBeginCapture(stream, cudaStreamCaptureModeGlobal);
-    if (cudaErr != cudaSuccess) f_exception(std::string("cudaStreamBeginCapture error"));
+void create_graph(device_stream stream, device_graph& graph, double* d_A, double* d_Anew) {
+    dim3 grid = cover_grid(n);
+    dim3 block(block_side, block_side);
+    range_push("createGraph");
+    // захват операций на потоке stream и создание исполняемого графа
+    graph_capture_begin(stream);
     for (int i = 0; i < graph_step; i++)
-        calc_mean<<<grid, block, 0, stream>>>(d_A, d_Anew, n, (i % 2 == 1));
-    // завершение захвата операций
-    cudaErr = cudaStreamEndCapture(stream, &graph);
-    if (cudaErr != cudaSuccess) f_exception(std::string("cudaStreamEndCapture error"));
-    nvtxRangePop();
-    // создаем исполняемый граф
-    cudaErr = cudaGraphInstantiate(&instance, graph, NULL, NULL, 0);
-    if (cudaErr != cudaSuccess) f_exception(std::string("cudaGraphInstantiate error"));
+        DEVICE_LAUNCH(calc_mean, grid, block, stream, d_A, d_Anew, n, (i % 2 == 1));
+    graph_capture_end(stream, graph);
+    range_pop();
 }
 
 int parse_args(int argc, char** argv) {
@@ -164,22 +132,12 @@ int main(int argc, char **argv) {
     double* A = A_ptr.get();
     double* Anew = Anew_ptr.get();
 
-    std::string cudaMalloc_err = "cudaMalloc error";
-    std::string cudaMemcpy_err = "cudaMemcpy error";
-    std::string cudaGraphLaunch_err = "cudaGraphLaunch error";
-    std::string cudaStreamCreate_err = "cudaStreamCreate error";
-
-    dim3 grid(32, 32);
-    dim3 block(32, 32);
+    dim3 grid = cover_grid(n);
+    dim3 block(block_side, block_side);
 
-    cudaError_t cudaErr = cudaSuccess;
-    cudaStream_t stream;
-    
-    cudaErr = cudaStreamCreate(&stream);
-    if (cudaErr != cudaSuccess) f_exception(cudaStreamCreate_err);  
+    device_stream stream = stream_create();
 
     cuda_unique_ptr<double> d_unique_ptr_error(cuda_new<double>(1), cuda_free<double>);
-    cuda_unique_ptr<void> d_unique_ptr_temp_storage(cuda_new<void>(0), cuda_free<void>);
 
     cuda_unique_ptr<double> d_unique_ptr_A(cuda_new<double>(n*n), cuda_free<double>);
     cuda_unique_ptr<double> d_unique_ptr_Anew(cuda_new<double>(n*n), cuda_free<double>);
@@ -191,58 +149,47 @@ int main(int argc, char **argv) {
 	double *d_Anew = d_unique_ptr_Anew.get();
     double *d_subtr_temp = d_unique_ptr_subtr_temp.get();
 
-    // копирование матриц с хоста на gpu
-    cudaErr = cudaMemcpy(d_A, A, n * n * sizeof(double), cudaMemcpyHostToDevice);
-    if (cudaErr != cudaSuccess) f_exception(cudaMemcpy_err);
-    cudaErr = cudaMemcpy(d_Anew, Anew, n * n * sizeof(double), cudaMemcpyHostToDevice);
-    if (cudaErr != cudaSuccess) f_exception(cudaMemcpy_err);
+    // копирование матриц с хоста на устройство
+    copy_to_device(d_A, A, n * n);
+    copy_to_device(d_Anew, Anew, n * n);
 
-    // проверка памяти для редукции
-    void *d_temp_storage = d_unique_ptr_temp_storage.get();
-    size_t temp_storage_bytes = 0;
-    cub::DeviceReduce::Max(d_temp_storage, temp_storage_bytes, d_Anew, d_error_ptr, n * n, stream);
-    cudaErr = cudaMalloc((void**)&d_temp_storage, temp_storage_bytes);
-    if (cudaErr != cudaSuccess) f_exception(cudaMalloc_err);
+    // память для редукции
+    device_max reduce_max(d_subtr_temp, d_error_ptr, n * n, stream);
 
     // printf("Jacobi relaxation Calculation: %d x %d mesh\n", n, n);
 
-    cudaGraph_t graph;
-    cudaGraphExec_t instance;
+    device_graph graph;
 
     int iter = 0;
     double error = eps + 1.0;
-    create_graph(stream, graph, instance, d_A, d_Anew);
+    create_graph(stream, graph, d_A, d_Anew);
 
-    nvtxRangePushA("while");
+    range_push("while");
     auto start_time = std::chrono::steady_clock::now();
     while (error > eps && iter < max_iters) {
         // старт графа
-        nvtxRangePushA("startGraph");
-        cudaErr = cudaGraphLaunch(instance, stream);
-        if (cudaErr != cudaSuccess) f_exception(cudaGraphLaunch_err);
-        nvtxRangePop();
+        range_push("startGraph");
+        graph_launch(graph, stream);
+        range_pop();
 
         iter += graph_step;
         if (iter % graph_step == 0) {
-            nvtxRangePushA("calcError");
-            sub_mats<<<grid, block, 0, stream>>>(d_A, d_Anew, d_subtr_temp, n);
-            cub::DeviceReduce::Max(d_temp_storage, temp_storage_bytes, d_subtr_temp, d_error_ptr, n * n, stream);
-            cudaErr = cudaMemcpy(&error, d_error_ptr, sizeof(double), cudaMemcpyDeviceToHost);
-            if (cudaErr != cudaSuccess) f_exception(cudaMemcpy_err);
-            nvtxRangePop();
+            range_push("calcError");
+            DEVICE_LAUNCH(sub_mats, grid, block, stream, d_A, d_Anew, d_subtr_temp, n);
+            reduce_max(d_subtr_temp, d_error_ptr, n * n, stream);
+            copy_to_host(&error, d_error_ptr, 1);
+            range_pop();
         }
     }
-    nvtxRangePop();
+    range_pop();
     auto end_time = std::chrono::steady_clock::now();
     std::chrono::duration<double> dur = end_time - start_time;
 
-    cudaErr = cudaMemcpy(A, d_A, n * n * sizeof(double), cudaMemcpyDeviceToHost);
-    if (cudaErr != cudaSuccess) f_exception(cudaMemcpy_err);
+    copy_to_host(A, d_A, n * n);
 
     // освобождение ресурсов
-    cudaStreamDestroy(stream);
-    cudaGraphDestroy(graph);
-    cudaGraphExecDestroy(instance);
+    graph_destroy(graph);
+    stream_destroy(stream);
 
     std::cout << "Iters: " << iter << "\n";
     std::cout << "Error: " << error << "\n";